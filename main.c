@@ -6,11 +6,327 @@
 #include "unstd.h"
 #include "rc_test.h"
 #include <string.h>
+#include <errno.h>
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+// rc c <in> <out>  compress
+// rc d <in> <out>  decompress
+// rc t <in>        test integrity of compressed file
+// "-" stands for stdin/stdout, stdin is streamed in constant memory
+// options: --threads N --chunk MB --rans --lanes
+//
+// no command runs tests:
 // --verbose --randomize --iterations 2
 // -i 99 -v -r
 
+struct file_map {
+    uint8_t* data;
+    size_t   bytes;
+    bool     mapped; // memory mapped file otherwise malloc()-ed memory
+    #ifdef _WIN32
+    HANDLE   file;
+    HANDLE   mapping;
+    #else
+    int      fd;
+    #endif
+};
+
+static bool is_std(const char* name) { return strcmp(name, "-") == 0; }
+
+static int32_t map_input(const char* name, struct file_map* m) {
+    memset(m, 0, sizeof(*m));
+    #ifdef _WIN32
+        m->file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, null,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, null);
+        if (m->file == INVALID_HANDLE_VALUE) { return rc_err_io; }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m->file, &size)) {
+            CloseHandle(m->file);
+            return rc_err_io;
+        }
+        m->bytes = (size_t)size.QuadPart;
+        if (m->bytes > 0) {
+            m->mapping = CreateFileMappingA(m->file, null, PAGE_READONLY,
+                                            0, 0, null);
+            m->data = m->mapping == null ? null :
+                (uint8_t*)MapViewOfFile(m->mapping, FILE_MAP_READ, 0, 0, 0);
+            if (m->data == null) {
+                if (m->mapping != null) { CloseHandle(m->mapping); }
+                CloseHandle(m->file);
+                return rc_err_io;
+            }
+        }
+    #else
+        m->fd = open(name, O_RDONLY);
+        if (m->fd < 0) { return errno; }
+        struct stat st;
+        if (fstat(m->fd, &st) != 0) {
+            int32_t r = errno;
+            close(m->fd);
+            return r;
+        }
+        m->bytes = (size_t)st.st_size;
+        if (m->bytes > 0) {
+            void* a = mmap(null, m->bytes, PROT_READ, MAP_PRIVATE, m->fd, 0);
+            if (a == MAP_FAILED) {
+                int32_t r = errno;
+                close(m->fd);
+                return r;
+            }
+            m->data = (uint8_t*)a;
+            posix_madvise(a, m->bytes, POSIX_MADV_SEQUENTIAL);
+        }
+    #endif
+    m->mapped = true;
+    return 0;
+}
+
+static int32_t map_output(const char* name, size_t bytes,
+                          struct file_map* m) {
+    // output of known size: memory mapped file or buffer for stdout
+    memset(m, 0, sizeof(*m));
+    m->bytes = bytes;
+    if (is_std(name) || bytes == 0) {
+        m->data = (uint8_t*)malloc(max(bytes, (size_t)1));
+        return m->data != null ? 0 : rc_err_no_memory;
+    }
+    #ifdef _WIN32
+        m->file = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, null,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, null);
+        if (m->file == INVALID_HANDLE_VALUE) { return rc_err_io; }
+        const uint64_t size = bytes;
+        m->mapping = CreateFileMappingA(m->file, null, PAGE_READWRITE,
+                                        (DWORD)(size >> 32), (DWORD)size,
+                                        null);
+        m->data = m->mapping == null ? null :
+            (uint8_t*)MapViewOfFile(m->mapping, FILE_MAP_WRITE, 0, 0, 0);
+        if (m->data == null) {
+            if (m->mapping != null) { CloseHandle(m->mapping); }
+            CloseHandle(m->file);
+            return rc_err_io;
+        }
+    #else
+        m->fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (m->fd < 0) { return errno; }
+        void* a = MAP_FAILED;
+        if (ftruncate(m->fd, (off_t)bytes) == 0) {
+            a = mmap(null, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     m->fd, 0);
+        }
+        if (a == MAP_FAILED) {
+            int32_t r = errno;
+            close(m->fd);
+            return r;
+        }
+        m->data = (uint8_t*)a;
+    #endif
+    m->mapped = true;
+    return 0;
+}
+
+static void unmap(struct file_map* m) {
+    if (!m->mapped) {
+        free(m->data);
+    } else {
+        #ifdef _WIN32
+            if (m->data != null) {
+                UnmapViewOfFile(m->data);
+                CloseHandle(m->mapping);
+            }
+            CloseHandle(m->file);
+        #else
+            if (m->data != null) { munmap(m->data, m->bytes); }
+            close(m->fd);
+        #endif
+    }
+    memset(m, 0, sizeof(*m));
+}
+
+static int32_t write_file(const char* name, const uint8_t* data,
+                          size_t bytes) {
+    FILE* f = stdout;
+    if (is_std(name)) {
+        #ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+        #endif
+    } else {
+        f = fopen(name, "wb");
+        if (f == null) { return errno; }
+    }
+    int32_t r = fwrite(data, 1, bytes, f) == bytes ? 0 : rc_err_io;
+    if (fflush(f) != 0 && r == 0) { r = rc_err_io; }
+    if (f != stdout && fclose(f) != 0 && r == 0) { r = rc_err_io; }
+    return r;
+}
+
+static void report(const char* verb, size_t in, size_t out, uint64_t ns) {
+    const double mb = 1024.0 * 1024.0;
+    const size_t raw = strcmp(verb, "compressed") == 0 ? in : out;
+    fprintf(stderr, "%s %llu to %llu bytes %.1f%% in %.3fs %.1f MB/s\n",
+            verb, (unsigned long long)in, (unsigned long long)out,
+            in > 0 ? out * 100.0 / in : 0.0, ns / 1e9,
+            raw / mb / (ns / 1e9 + 1e-9));
+}
+
+static int32_t stream(const char* to, const struct rb_options* o,
+                      bool encode) {
+    // stdin is coded in constant memory without the chunk index
+    #ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    #endif
+    FILE* f = stdout;
+    if (to == null || is_std(to)) {
+        #ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+        #endif
+    } else {
+        f = fopen(to, "wb");
+        if (f == null) { return errno; }
+    }
+    enum { size = 1024 * 1024 };
+    uint8_t* buffer = (uint8_t*)malloc(size * 2);
+    struct rb_stream s;
+    int32_t r = encode ? rb_stream_encoder(&s, o) : rb_stream_decoder(&s);
+    if (buffer == null && r == 0) { r = rc_err_no_memory; }
+    const uint64_t start = nanoseconds();
+    bool eof = false;
+    while (r == 0 && !s.end) {
+        if (s.avail_in == 0 && !eof) {
+            s.next_in  = buffer;
+            s.avail_in = fread(buffer, 1, size, stdin);
+            if (ferror(stdin)) { r = rc_err_io; }
+            eof = s.avail_in == 0;
+        }
+        s.next_out  = buffer + size;
+        s.avail_out = size;
+        if (r == 0) {
+            r = encode ? rb_stream_encode(&s, eof) : rb_stream_decode(&s);
+        }
+        const size_t n = size - s.avail_out;
+        if (r == 0 && to != null && fwrite(buffer + size, 1, n, f) != n) {
+            r = rc_err_io;
+        }
+        if (r == 0 && !encode && eof && !s.end && s.avail_out > 0) {
+            r = rc_err_data; // truncated
+        }
+    }
+    const uint64_t time = nanoseconds() - start;
+    if (to != null && fflush(f) != 0 && r == 0) { r = rc_err_io; }
+    if (f != stdout && fclose(f) != 0 && r == 0) { r = rc_err_io; }
+    if (r == 0) {
+        report(encode ? "compressed" : to == null ? "tested" : "decompressed",
+               (size_t)s.total_in, (size_t)s.total_out, time);
+    }
+    rb_stream_fini(&s);
+    free(buffer);
+    return r;
+}
+
+static int32_t compress(const char* from, const char* to,
+                        const struct rb_options* o) {
+    if (is_std(from)) { return stream(to, o, true); }
+    struct file_map in;
+    int32_t r = map_input(from, &in);
+    if (r == 0) {
+        const size_t bound = rb_bound(in.bytes, o);
+        uint8_t* out = (uint8_t*)malloc(bound);
+        size_t written = 0;
+        if (out == null) { r = rc_err_no_memory; }
+        const uint64_t start = nanoseconds();
+        if (r == 0) {
+            r = rb_compress(in.data, in.bytes, out, bound, &written, o);
+        }
+        const uint64_t time = nanoseconds() - start;
+        if (r == 0) { r = write_file(to, out, written); }
+        if (r == 0) { report("compressed", in.bytes, written, time); }
+        free(out);
+        unmap(&in);
+    }
+    return r;
+}
+
+static int32_t decompress(const char* from, const char* to,
+                          const struct rb_options* o) {
+    // `to` == null only tests integrity of the compressed data
+    if (is_std(from)) { return stream(to, o, false); }
+    struct file_map in;
+    struct rb_info  info;
+    int32_t r = map_input(from, &in);
+    if (r == 0) {
+        r = rb_info(in.data, in.bytes, &info);
+        struct file_map out = {0};
+        if (r == 0) {
+            r = map_output(to == null ? "-" : to, info.bytes, &out);
+        }
+        size_t written = 0;
+        const uint64_t start = nanoseconds();
+        if (r == 0) {
+            r = rb_decompress(in.data, in.bytes, out.data, out.bytes,
+                              &written, o);
+        }
+        const uint64_t time = nanoseconds() - start;
+        if (r == 0 && to != null && !out.mapped) {
+            r = write_file(to, out.data, written);
+        }
+        if (r == 0) {
+            report(to == null ? "tested" : "decompressed",
+                   in.bytes, written, time);
+        }
+        unmap(&out);
+        unmap(&in);
+    }
+    return r;
+}
+
+static int command(int argc, const char* argv[]) {
+    struct rb_options o = {0};
+    const char* files[2] = { null, null };
+    int32_t n = 0;
+    for (int i = 2; i < argc; i++) {
+        if (i < argc - 1 && strcmp(argv[i], "--threads") == 0) {
+            o.threads = atoi(argv[++i]);
+        } else if (i < argc - 1 && strcmp(argv[i], "--chunk") == 0) {
+            o.chunk = (size_t)atoi(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--rans") == 0) {
+            o.method = rb_method_rans;
+        } else if (strcmp(argv[i], "--lanes") == 0) {
+            o.method = rb_method_lanes;
+        } else if (strcmp(argv[i], "--lz") == 0) {
+            o.method = rb_method_lz;
+        } else if (i < argc - 1 && strcmp(argv[i], "--level") == 0) {
+            o.level = atoi(argv[++i]);
+        } else if (n < (int32_t)countof(files)) {
+            files[n++] = argv[i];
+        } else {
+            n++;
+        }
+    }
+    const char c = argv[1][0];
+    if (n != (c == 't' ? 1 : 2)) {
+        fprintf(stderr, "usage: rc c|d <in> <out> | rc t <in> "
+                        "[--threads N] [--chunk MB] [--rans|--lanes|--lz] "
+                        "[--level 1..9]\n");
+        return 1;
+    }
+    int32_t r = c == 'c' ? compress(files[0], files[1], &o) :
+                c == 'd' ? decompress(files[0], files[1], &o) :
+                           decompress(files[0], null, &o);
+    if (r != 0) { fprintf(stderr, "error: %d %s\n", r, strerror(r)); }
+    return r == 0 ? 0 : 1;
+}
+
 int main(int argc, const char* argv[]) {
+    if (argc > 1 && argv[1][0] != 0 && argv[1][1] == 0 &&
+        strchr("cdt", argv[1][0]) != null) {
+        return command(argc, argv);
+    }
     int iterations = 1;
     bool verbose   = false;
     bool randomize = false;
@@ -16,6 +16,12 @@
 #define rc_sym_count (1uLL << rc_sym_bits)
 #define pm_max_freq  (1uLL << (64 - rc_sym_bits))
 #define ft_max_bits  31
+#define cm_default_inc   32
+#define cm_default_limit (1u << 16)
+#define sm_bits          12 // static model total frequency 1 << sm_bits
+#define sm_total         (1u << sm_bits)
+#define rc_price_bits    4 // prices in 1/16 bit units
+#define rc_price_max     (64u << rc_price_bits)
 
 // See: posix errno.h https://pubs.opengroup.org/onlinepubs/9699919799/
 // Range coder errors can be any values != 0 but for the convenience
@@ -36,31 +42,223 @@ struct prob_model  { // probability model
     uint64_t tree[rc_sym_count]; // Fenwick Tree
 };
 
+struct compact_model { // 1KB vs 4KB of prob_model
+    uint32_t tree[rc_sym_count]; // Fenwick Tree, frequencies are derived
+    uint32_t inc;   // increment of the frequency of the coded symbol
+    uint32_t limit; // total frequency that triggers halving rescale
+};
+
+struct static_model { // semi-static (two pass) model
+    uint16_t freq[rc_sym_count];  // normalized to sum of sm_total
+    uint16_t start[rc_sym_count]; // cumulative frequencies
+    uint8_t  slot[sm_total];      // cumulative frequency -> symbol
+};
+
+struct price_table { // approximate cost of symbols
+    uint32_t cost[rc_sym_count]; // in 1 / (1 << rc_price_bits) bits
+};
+
 struct range_coder {
     uint64_t low;
     uint64_t range;
     uint64_t code;
     void    (*write)(struct range_coder*, uint8_t);
     uint8_t (*read)(struct range_coder*);
+    // Buffered I/O: when `data` is not null the coder writes (encoder)
+    // or reads (decoder) bytes data[next..count) directly and calls
+    // flush()/refill() only when the span is exhausted. Both callbacks
+    // are expected to set up new `data`, `count` and reset `next`.
+    // When `data` is null per byte write()/read() callbacks are used.
+    uint8_t* data;
+    size_t   count; // number of bytes in data[] (or capacity for encoder)
+    size_t   next;  // index of the next byte to be written or read
+    void    (*flush)(struct range_coder*);  // encoder: data[0..next) is full
+    void    (*refill)(struct range_coder*); // decoder: data[] is exhausted
     int32_t  error; // sticky error (e.g. errno_t from read/write)
 };
 
 void    pm_init(struct prob_model* pm, uint32_t n); // n <= 256
 void    pm_update(struct prob_model* pm, uint8_t sym, uint64_t inc);
 
-// decoder needs first 8 bytes in code
+// I/O is set up before rc_init() which only resets the coder state:
+// rc_callbacks() selects per byte write()/read() (the one not used may
+// be null) and clears the span and flush()/refill(). rc_span() selects
+// buffered I/O and keeps flush()/refill() as set by the caller, e.g.
+// after rc_callbacks(rc, null, null) or on a zero initialized coder.
+// Decoder needs first 8 bytes in code.
 
+void    rc_callbacks(struct range_coder* rc,
+                     void (*write)(struct range_coder*, uint8_t),
+                     uint8_t (*read)(struct range_coder*));
 void    rc_init(struct range_coder* rc, uint64_t code);
+void    rc_span(struct range_coder* rc, uint8_t data[], size_t count);
 void    rc_encode(struct range_coder* rc, struct prob_model* pm, uint8_t sym);
 uint8_t rc_decode(struct range_coder* rc, struct prob_model* pm);
 
+// Bulk versions of rc_encode()/rc_decode() producing bit identical
+// streams. Coder state is kept in local variables for the whole
+// array and errors are only reported via rc->error at the end.
+// rc_decode_array() returns number of decoded symbols (< count on error).
+
+void    rc_encode_array(struct range_coder* rc, struct prob_model* pm,
+                        const uint8_t data[], size_t count);
+size_t  rc_decode_array(struct range_coder* rc, struct prob_model* pm,
+                        uint8_t data[], size_t count);
+
+// Coding of the interval [start..start + size) out of total for
+// models other than prob_model. Underflow is resolved before each
+// symbol (instead of after as rc_encode() does) thus total can change
+// arbitrary between symbols e.g. on rescale. With prob_model
+// start/size/total and pm_update(pm, sym, 1) the stream is bit identical
+// to rc_encode(). Decoder calls rc_decode_freq() to obtain cumulative
+// frequency inside the next symbol interval (>= total if input is
+// corrupted), looks up the symbol and calls rc_decode_range().
+
+void     rc_encode_range(struct range_coder* rc, uint64_t start,
+                         uint64_t size, uint64_t total);
+uint64_t rc_decode_freq(struct range_coder* rc, uint64_t total);
+void     rc_decode_range(struct range_coder* rc, uint64_t start,
+                         uint64_t size);
+
+// Direct (bypass) coding of 0..32 equiprobable bits without a model:
+// the encoder scales the range with a shift instead of a division and
+// no frequencies are updated. The stream is bit identical to
+// rc_encode_range(rc, value, 1, 1uLL << bits) and can be mixed with
+// any other models. Decoder sets rc->error to rc_err_data on corrupted
+// input.
+
+void     rc_encode_bits(struct range_coder* rc, uint32_t value,
+                        uint32_t bits);
+uint32_t rc_decode_bits(struct range_coder* rc, uint32_t bits);
+
+// Compact adaptive model: 32 bit counters, halves all frequencies
+// (keeping them non zero) when total exceeds `limit` so it keeps
+// adapting to nonstationary data. Caller may change `inc` and `limit`
+// after cm_init() (limit + inc < 2^32).
+
+void     cm_init(struct compact_model* cm, uint32_t n); // n <= 256
+void     cm_update(struct compact_model* cm, uint8_t sym);
+uint32_t cm_freq(const struct compact_model* cm, uint8_t sym);
+void     cm_encode(struct range_coder* rc, struct compact_model* cm,
+                   uint8_t sym);
+uint8_t  cm_decode(struct range_coder* rc, struct compact_model* cm);
+
+// Compile time sized probability models for small alphabets:
+// pm_declare(2) declares struct prob_model_2 with 4 symbols and
+// pm_init_2(), pm_update_2(), rc_encode_2(), rc_decode_2() static
+// functions. Trees of 1 << bits entries instead of 256. Output is bit
+// identical to prob_model initialized with pm_init(pm, 1 << bits).
+
+#define pm_declare(bits)                                                    \
+struct prob_model_##bits {                                                  \
+    uint64_t freq[1u << (bits)];                                            \
+    uint64_t tree[1u << (bits)]; /* Fenwick Tree */                         \
+};                                                                          \
+                                                                            \
+static void pm_init_##bits(struct prob_model_##bits* pm) {                  \
+    enum { n = 1u << (bits) };                                              \
+    static_assert(1 <= (bits) && (bits) <= rc_sym_bits, "1..8 bits");       \
+    for (int32_t i = 0; i < n; i++) { pm->freq[i] = 1; pm->tree[i] = 1; }   \
+    for (int32_t i = 1; i <= n; i++) {                                      \
+        const int32_t parent = i + (i & -i);                                \
+        if (parent <= n) { pm->tree[parent - 1] += pm->tree[i - 1]; }       \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+static inline void pm_update_##bits(struct prob_model_##bits* pm,          \
+                                    uint8_t sym, uint64_t inc) {            \
+    enum { n = 1u << (bits) };                                              \
+    /* sym >= n is ignored (would write past freq[] and tree[]) */          \
+    if (sym < n && pm->tree[n - 1] < pm_max_freq) { /* pm_update() */       \
+        pm->freq[sym] += inc;                                               \
+        for (int32_t i = sym; i < n; i += (i + 1) & -(i + 1)) {             \
+            pm->tree[i] += inc;                                             \
+        }                                                                   \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+static inline void rc_encode_##bits(struct range_coder* rc,                 \
+                                    struct prob_model_##bits* pm,           \
+                                    uint8_t sym) {                          \
+    enum { n = 1u << (bits) };                                              \
+    if (sym >= n) { /* symbol is not in the alphabet */                     \
+        if (rc->error == 0) { rc->error = rc_err_invalid; }                 \
+        return;                                                             \
+    }                                                                       \
+    uint64_t start = 0;                                                     \
+    for (int32_t i = sym; i > 0; i -= i & -i) { start += pm->tree[i - 1]; } \
+    rc_encode_range(rc, start, pm->freq[sym], pm->tree[n - 1]);             \
+    pm_update_##bits(pm, sym, 1);                                           \
+}                                                                           \
+                                                                            \
+static inline uint8_t rc_decode_##bits(struct range_coder* rc,              \
+                                       struct prob_model_##bits* pm) {      \
+    enum { n = 1u << (bits) };                                              \
+    const uint64_t total = pm->tree[n - 1];                                 \
+    const uint64_t sum = rc_decode_freq(rc, total);                         \
+    if (sum >= total) {                                                     \
+        if (rc->error == 0) { rc->error = rc_err_data; }                    \
+        return 0;                                                           \
+    }                                                                       \
+    uint64_t v = sum;                                                       \
+    uint32_t sym = 0;                                                       \
+    for (uint32_t mask = n >> 1; mask != 0; mask >>= 1) {                   \
+        const uint64_t t = pm->tree[sym + mask - 1];                        \
+        if (v >= t) { sym += mask; v -= t; }                                \
+    }                                                                       \
+    rc_decode_range(rc, sum - v, pm->freq[sym]);                            \
+    pm_update_##bits(pm, (uint8_t)sym, 1);                                  \
+    return (uint8_t)sym;                                                    \
+}
+
+// Semi-static model for data known in advance: sm_init() normalizes
+// the histogram of the block to the power of 2 total, sm_write()
+// stores normalized frequencies in the stream and sm_read() restores
+// them. Encoder scales the range with a shift instead of division and
+// decoder maps cumulative frequency to the symbol with direct lookup.
+// sm_histogram() adds symbol counts of data[] to histogram[].
+// sm_entropy() estimates order 0 coded size of the histogram in
+// 1 / (1 << rc_price_bits) bits with rc_log2_price() (no floating
+// point log2()) thus preflight of a block (stored, static or adaptive
+// coding, see rc_block.h) costs a histogram pass and 256 lookups.
+// sm_init() returns rc_err_invalid if histogram is all zeros.
+
+void    sm_histogram(uint64_t histogram[rc_sym_count],
+                     const uint8_t data[], size_t count);
+uint64_t sm_entropy(const uint64_t histogram[rc_sym_count]);
+int32_t sm_init(struct static_model* sm,
+                const uint64_t histogram[rc_sym_count]);
+void    sm_write(struct range_coder* rc, const struct static_model* sm);
+void    sm_read(struct range_coder* rc, struct static_model* sm);
+void    sm_encode_array(struct range_coder* rc, const struct static_model* sm,
+                        const uint8_t data[], size_t count);
+size_t  sm_decode_array(struct range_coder* rc, const struct static_model* sm,
+                        uint8_t data[], size_t count);
+
+// Price tables: approximate cost of coding a symbol with prob_model
+// -log2(freq / total) in 1 / (1 << rc_price_bits) bits is computed
+// from a leading zeros count and a 64 entries log2 lookup table
+// (error < 1/8 bit). pm_cost() prices a single symbol, pm_prices()
+// fills the table for all symbols thus parsers that query costs
+// millions of times (see rc_lz.h optimal parse) can refresh tables
+// periodically instead of after every coded symbol. Symbols with
+// zero frequency cost rc_price_max.
+
+uint32_t rc_log2_price(uint64_t x); // log2(x) << rc_price_bits, x > 0
+uint32_t pm_cost(const struct prob_model* pm, uint8_t sym);
+void     pm_prices(const struct prob_model* pm, struct price_table* pt);
+
 // it is responsibility of the called to initialize the range_coder
 
 #endif // rc_header_included
 
-#ifdef rc_implementation
+#if defined(rc_implementation) && !defined(rc_implementation_included)
+#define rc_implementation_included // other rc_*.h headers include rc.h
 
 #include "unstd.h"
+#ifdef _MSC_VER
+#include <intrin.h> // _BitScanReverse64(), _BitScanReverse()
+#endif
 
 static inline int32_t ft_lsb(int32_t i) { // least significant bit only
     assert(0 < i && i < (1uLL << ft_max_bits)); // 0 will lead to endless loop
@@ -186,13 +384,43 @@ void pm_update(struct prob_model* pm, uint8_t sym, uint64_t inc) {
     }
 }
 
+static void rc_drain(struct range_coder* rc) { // output span is full
+    if (rc->flush != null && rc->error == 0) { rc->flush(rc); }
+    if (rc->next >= rc->count && rc->error == 0) {
+        rc->error = rc_err_no_space;
+    }
+}
+
+static void rc_replenish(struct range_coder* rc) { // input span is exhausted
+    if (rc->refill != null && rc->error == 0) { rc->refill(rc); }
+    if (rc->next >= rc->count && rc->error == 0) { rc->error = rc_err_io; }
+}
+
+static inline void rc_out(struct range_coder* rc, uint8_t byte) {
+    if (rc->data != null) {
+        if (rc->next >= rc->count) { rc_drain(rc); }
+        if (rc->next <  rc->count) { rc->data[rc->next++] = byte; }
+    } else {
+        rc->write(rc, byte);
+    }
+}
+
+static inline uint8_t rc_in(struct range_coder* rc) {
+    if (rc->data != null) {
+        if (rc->next >= rc->count) { rc_replenish(rc); }
+        return rc->next < rc->count ? rc->data[rc->next++] : 0;
+    } else {
+        return rc->read(rc);
+    }
+}
+
 static void rc_emit(struct range_coder* rc) {
     #ifdef rc_debug
     const uint64_t range = rc->range;
     const uint64_t low = rc->low;
     #endif
     const uint8_t byte = (uint8_t)(rc->low >> 56);
-    rc->write(rc, byte);
+    rc_out(rc, byte);
     rc->low   <<= 8;
     rc->range <<= 8;
     assert(rc->range != 0);
@@ -206,6 +434,18 @@ static inline bool rc_leftmost_byte_is_same(struct range_coder* rc) {
     return (rc->low >> 56) == ((rc->low + rc->range) >> 56);
 }
 
+void rc_callbacks(struct range_coder* rc,
+                  void (*write)(struct range_coder*, uint8_t),
+                  uint8_t (*read)(struct range_coder*)) {
+    rc->write  = write;
+    rc->read   = read;
+    rc->data   = null; // per byte I/O
+    rc->count  = 0;
+    rc->next   = 0;
+    rc->flush  = null;
+    rc->refill = null;
+}
+
 void rc_init(struct range_coder* rc, uint64_t code) {
     rc->low   = 0;
     rc->range = UINT64_MAX;
@@ -213,11 +453,24 @@ void rc_init(struct range_coder* rc, uint64_t code) {
     rc->error = 0;
 }
 
+void rc_span(struct range_coder* rc, uint8_t data[], size_t count) {
+    // switches range coder to buffered I/O on data[0..count)
+    // flush and refill callbacks (if any) must be set by the caller
+    rc->data  = data;
+    rc->count = count;
+    rc->next  = 0;
+}
+
 static void rc_flush(struct range_coder* rc) {
     for (int i = 0; i < sizeof(rc->low); i++) {
         rc->range = UINT64_MAX;
         rc_emit(rc);
     }
+    // buffered encoder: hand remaining data[0..next) to the caller
+    if (rc->data != null && rc->next > 0 && rc->flush != null &&
+        rc->error == 0) {
+        rc->flush(rc);
+    }
 }
 
 static void rc_consume(struct range_coder* rc) {
@@ -226,7 +479,7 @@ static void rc_consume(struct range_coder* rc) {
     const uint64_t code  = rc->code;
     const uint64_t low   = rc->low;
     #endif
-    const uint8_t byte   = rc->read(rc);
+    const uint8_t byte   = rc_in(rc);
     rc->code    = (rc->code << 8) + byte;
     rc->low   <<= 8;
     rc->range <<= 8;
@@ -249,6 +502,11 @@ void rc_encode(struct range_coder* rc, struct prob_model* pm,
     uint64_t total = pm_total_freq(pm);
     uint64_t start = pm_sum_of(pm, sym);
     uint64_t size  = pm->freq[sym];
+    if (rc->range < total) { // after other coders (e.g. rc_binary.h)
+        rc_emit(rc);
+        rc_emit(rc);
+        rc->range = UINT64_MAX - rc->low;
+    }
     assert(rc->range >= total);
     rc->range /= total;
     rc->low   += start * rc->range;
@@ -305,4 +563,504 @@ uint8_t rc_decode(struct range_coder* rc, struct prob_model* pm) {
     return (uint8_t)sym;
 }
 
+void rc_encode_array(struct range_coder* rc, struct prob_model* pm,
+                     const uint8_t data[], size_t count) {
+    uint64_t* tree  = pm->tree;
+    uint64_t* freq  = pm->freq;
+    uint64_t  low   = rc->low;
+    uint64_t  range = rc->range;
+    uint64_t  total = pm_total_freq(pm);
+    size_t i = 0;
+    while (i < count) {
+        const uint8_t  sym   = data[i];
+        const uint64_t start = ft_query(tree, rc_sym_count, sym - 1);
+        const uint64_t size  = freq[sym];
+        if (size == 0) { break; } // symbol is not in the alphabet
+        if (range < total) { // only after other coders see rc_encode()
+            rc_out(rc, (uint8_t)(low >> 56)); low <<= 8;
+            rc_out(rc, (uint8_t)(low >> 56)); low <<= 8;
+            range = UINT64_MAX - low;
+        }
+        range /= total;
+        low   += start * range;
+        range *= size;
+        const uint64_t next = total + 1; // see rc_encode()
+        if (total < pm_max_freq) {
+            freq[sym]++;
+            ft_update(tree, rc_sym_count, sym, 1);
+            total++;
+        }
+        while ((low >> 56) == ((low + range) >> 56)) {
+            rc_out(rc, (uint8_t)(low >> 56));
+            low <<= 8;
+            range <<= 8;
+        }
+        if (range < next) {
+            rc_out(rc, (uint8_t)(low >> 56)); low <<= 8;
+            rc_out(rc, (uint8_t)(low >> 56)); low <<= 8;
+            range = UINT64_MAX - low;
+        }
+        i++;
+    }
+    rc->low   = low;
+    rc->range = range;
+    if (i < count && rc->error == 0) { rc->error = rc_err_invalid; }
+}
+
+size_t rc_decode_array(struct range_coder* rc, struct prob_model* pm,
+                       uint8_t data[], size_t count) {
+    uint64_t* tree  = pm->tree;
+    uint64_t* freq  = pm->freq;
+    uint64_t  low   = rc->low;
+    uint64_t  range = rc->range;
+    uint64_t  code  = rc->code;
+    uint64_t  total = pm_total_freq(pm);
+    size_t i = 0;
+    while (i < count) {
+        if (range < total) {
+            code = (code << 8) + rc_in(rc); low <<= 8;
+            code = (code << 8) + rc_in(rc); low <<= 8;
+            range = UINT64_MAX - low;
+        }
+        range /= total;
+        const uint64_t sum = (code - low) / range;
+        if (sum >= total) { break; } // corrupted input
+        // Fenwick tree descent (see ft_index_of()) also yields `start`
+        uint64_t v = sum;
+        uint32_t sym = 0;
+        for (uint32_t mask = rc_sym_count >> 1; mask != 0; mask >>= 1) {
+            const uint64_t t = tree[sym + mask - 1];
+            if (v >= t) { sym += mask; v -= t; }
+        }
+        const uint64_t start = sum - v;
+        low   += start * range;
+        range *= freq[sym];
+        if (total < pm_max_freq) {
+            freq[sym]++;
+            ft_update(tree, rc_sym_count, (int32_t)sym, 1);
+            total++;
+        }
+        while ((low >> 56) == ((low + range) >> 56)) {
+            code = (code << 8) + rc_in(rc);
+            low <<= 8;
+            range <<= 8;
+        }
+        data[i++] = (uint8_t)sym;
+    }
+    rc->low   = low;
+    rc->range = range;
+    rc->code  = code;
+    if (i < count && rc->error == 0) { rc->error = rc_err_data; }
+    return i;
+}
+
+void rc_encode_range(struct range_coder* rc, uint64_t start,
+                     uint64_t size, uint64_t total) {
+    assert(0 < size && start + size <= total && total <= pm_max_freq);
+    if (rc->range < total) {
+        rc_emit(rc);
+        rc_emit(rc);
+        rc->range = UINT64_MAX - rc->low;
+    }
+    rc->range /= total;
+    rc->low   += start * rc->range;
+    rc->range *= size;
+    while (rc_leftmost_byte_is_same(rc)) { rc_emit(rc); }
+}
+
+uint64_t rc_decode_freq(struct range_coder* rc, uint64_t total) {
+    if (total < 1) { rc_err(rc, rc_err_invalid); return UINT64_MAX; }
+    if (rc->range < total) {
+        rc_consume(rc);
+        rc_consume(rc);
+        rc->range = UINT64_MAX - rc->low;
+    }
+    rc->range /= total; // scaled by rc_decode_range()
+    return (rc->code - rc->low) / rc->range;
+}
+
+void rc_decode_range(struct range_coder* rc, uint64_t start, uint64_t size) {
+    rc->low   += start * rc->range;
+    rc->range *= size;
+    while (rc_leftmost_byte_is_same(rc)) { rc_consume(rc); }
+}
+
+void rc_encode_bits(struct range_coder* rc, uint32_t value, uint32_t bits) {
+    assert(bits <= 32 && (bits == 32 || value < (1uLL << bits)));
+    if (bits > 0) {
+        if (rc->range < (1uLL << bits)) { // see rc_encode_range()
+            rc_emit(rc);
+            rc_emit(rc);
+            rc->range = UINT64_MAX - rc->low;
+        }
+        rc->range >>= bits;
+        rc->low   += value * rc->range;
+        while (rc_leftmost_byte_is_same(rc)) { rc_emit(rc); }
+    }
+}
+
+uint32_t rc_decode_bits(struct range_coder* rc, uint32_t bits) {
+    assert(bits <= 32);
+    uint64_t value = 0;
+    if (bits > 0) {
+        if (rc->range < (1uLL << bits)) {
+            rc_consume(rc);
+            rc_consume(rc);
+            rc->range = UINT64_MAX - rc->low;
+        }
+        rc->range >>= bits;
+        value = (rc->code - rc->low) / rc->range;
+        if ((value >> bits) != 0) { return rc_err(rc, rc_err_data); }
+        rc->low += value * rc->range;
+        while (rc_leftmost_byte_is_same(rc)) { rc_consume(rc); }
+    }
+    return (uint32_t)value;
+}
+
+static void cm_build(uint32_t tree[]) { // frequencies -> Fenwick tree
+    const int32_t m = (int32_t)rc_sym_count;
+    for (int32_t i = 1; i <= m; i++) {
+        int32_t parent = i + ft_lsb(i);
+        if (parent <= m) { tree[parent - 1] += tree[i - 1]; }
+    }
+}
+
+static void cm_flatten(uint32_t tree[]) { // Fenwick tree -> frequencies
+    const int32_t m = (int32_t)rc_sym_count;
+    for (int32_t i = m; i >= 1; i--) {
+        int32_t parent = i + ft_lsb(i);
+        if (parent <= m) { tree[parent - 1] -= tree[i - 1]; }
+    }
+}
+
+static uint32_t cm_total(const struct compact_model* cm) {
+    return cm->tree[rc_sym_count - 1];
+}
+
+static uint32_t cm_sum_of(const struct compact_model* cm, uint8_t sym) {
+    uint32_t sum = 0; // of all frequencies before sym
+    for (int32_t i = sym; i > 0; i -= ft_lsb(i)) { sum += cm->tree[i - 1]; }
+    return sum;
+}
+
+static void cm_rescale(struct compact_model* cm) {
+    cm_flatten(cm->tree);
+    for (size_t i = 0; i < countof(cm->tree); i++) {
+        cm->tree[i] = (cm->tree[i] + 1) / 2; // non zero stays non zero
+    }
+    cm_build(cm->tree);
+}
+
+void cm_init(struct compact_model* cm, uint32_t n) {
+    swear(2 <= n && n <= rc_sym_count);
+    for (size_t i = 0; i < countof(cm->tree); i++) {
+        cm->tree[i] = i < n ? 1 : 0;
+    }
+    cm_build(cm->tree);
+    cm->inc   = cm_default_inc;
+    cm->limit = cm_default_limit;
+}
+
+uint32_t cm_freq(const struct compact_model* cm, uint8_t sym) {
+    // node `i` covers (i - lsb(i)..i]: subtract children nodes
+    const int32_t i = sym + 1;
+    const int32_t parent = i - ft_lsb(i);
+    uint32_t freq = cm->tree[i - 1];
+    for (int32_t j = i - 1; j > parent; j -= ft_lsb(j)) {
+        freq -= cm->tree[j - 1];
+    }
+    return freq;
+}
+
+void cm_update(struct compact_model* cm, uint8_t sym) {
+    assert(cm->inc > 0 && cm->limit < UINT32_MAX - cm->inc);
+    const int32_t m = (int32_t)rc_sym_count;
+    for (int32_t i = sym; i < m; i += ft_lsb(i + 1)) {
+        cm->tree[i] += cm->inc;
+    }
+    if (cm_total(cm) > cm->limit) { cm_rescale(cm); }
+}
+
+void cm_encode(struct range_coder* rc, struct compact_model* cm,
+               uint8_t sym) {
+    const uint32_t size = cm_freq(cm, sym);
+    if (size == 0) { // symbol is not in the alphabet
+        if (rc->error == 0) { rc->error = rc_err_invalid; }
+    } else {
+        rc_encode_range(rc, cm_sum_of(cm, sym), size, cm_total(cm));
+        cm_update(cm, sym);
+    }
+}
+
+uint8_t cm_decode(struct range_coder* rc, struct compact_model* cm) {
+    const uint32_t total = cm_total(cm);
+    const uint64_t sum = rc_decode_freq(rc, total);
+    if (sum >= total) { return rc_err(rc, rc_err_data); }
+    // Fenwick tree descent (see ft_index_of()) also yields `start`
+    uint32_t v = (uint32_t)sum;
+    uint32_t sym = 0;
+    for (uint32_t mask = rc_sym_count >> 1; mask != 0; mask >>= 1) {
+        const uint32_t t = cm->tree[sym + mask - 1];
+        if (v >= t) { sym += mask; v -= t; }
+    }
+    rc_decode_range(rc, (uint32_t)sum - v, cm_freq(cm, (uint8_t)sym));
+    cm_update(cm, (uint8_t)sym);
+    return (uint8_t)sym;
+}
+
+void sm_histogram(uint64_t histogram[rc_sym_count],
+                  const uint8_t data[], size_t count) {
+    // eight histograms break dependency chains on runs of the same
+    // symbol, bytes are extracted from 64 bit loads (one load per eight
+    // increments) and the merge loop is vectorized by the compiler
+    uint32_t h[8][rc_sym_count];
+    while (count > 0) {
+        memset(h, 0, sizeof(h));
+        const size_t n = min(count, (size_t)1 << 30); // uint32_t counters
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t w;
+            memcpy(&w, data + i, sizeof(w));
+            h[0][(uint8_t)(w >>  0)]++;
+            h[1][(uint8_t)(w >>  8)]++;
+            h[2][(uint8_t)(w >> 16)]++;
+            h[3][(uint8_t)(w >> 24)]++;
+            h[4][(uint8_t)(w >> 32)]++;
+            h[5][(uint8_t)(w >> 40)]++;
+            h[6][(uint8_t)(w >> 48)]++;
+            h[7][(uint8_t)(w >> 56)]++;
+        }
+        for (; i < n; i++) { h[0][data[i]]++; }
+        for (size_t k = 0; k < rc_sym_count; k++) {
+            h[0][k] += h[4][k]; // n < 2^30 fits into uint32_t
+            h[1][k] += h[5][k];
+            h[2][k] += h[6][k];
+            h[3][k] += h[7][k];
+        }
+        for (size_t k = 0; k < rc_sym_count; k++) {
+            histogram[k] += (uint64_t)h[0][k] + h[1][k] + h[2][k] + h[3][k];
+        }
+        data  += n;
+        count -= n;
+    }
+}
+
+static void sm_build(struct static_model* sm) {
+    uint32_t start = 0;
+    for (size_t i = 0; i < rc_sym_count; i++) {
+        sm->start[i] = (uint16_t)start;
+        memset(sm->slot + start, (uint8_t)i, sm->freq[i]);
+        start += sm->freq[i];
+    }
+    assert(start == sm_total);
+}
+
+int32_t sm_init(struct static_model* sm,
+                const uint64_t histogram[rc_sym_count]) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < rc_sym_count; i++) { total += histogram[i]; }
+    if (total == 0) { return rc_err_invalid; }
+    // each present symbol gets at least 1 out of sm_total
+    int32_t sum = 0;
+    size_t  top = 0; // most frequent symbol
+    for (size_t i = 0; i < rc_sym_count; i++) {
+        uint32_t f = 0;
+        if (histogram[i] > 0) {
+            f = (uint32_t)((double)histogram[i] * sm_total / total + 0.5);
+            f = max(f, 1u);
+        }
+        sm->freq[i] = (uint16_t)f;
+        sum += (int32_t)f;
+        if (histogram[i] > histogram[top]) { top = i; }
+    }
+    // rounding error is absorbed by the most frequent symbols
+    while (sum != sm_total) {
+        if (sum < (int32_t)sm_total) {
+            sm->freq[top] += (uint16_t)(sm_total - sum);
+            sum = sm_total;
+        } else {
+            size_t k = 0;
+            for (size_t i = 1; i < rc_sym_count; i++) {
+                if (sm->freq[i] > sm->freq[k]) { k = i; }
+            }
+            const int32_t d = min(sum - (int32_t)sm_total,
+                                  (int32_t)sm->freq[k] - 1);
+            sm->freq[k] -= (uint16_t)d;
+            sum -= d;
+        }
+    }
+    sm_build(sm);
+    return 0;
+}
+
+// frequencies are stored as the number of significant bits (adaptive)
+// followed by the bits below the most significant one (uniform)
+
+enum { sm_freq_bits = sm_bits + 2 }; // 0..sm_bits + 1 significant bits
+
+void sm_write(struct range_coder* rc, const struct static_model* sm) {
+    struct compact_model cm;
+    cm_init(&cm, sm_freq_bits);
+    for (size_t i = 0; i < rc_sym_count; i++) {
+        const uint32_t f = sm->freq[i];
+        uint8_t b = 0;
+        while ((f >> b) != 0) { b++; }
+        cm_encode(rc, &cm, b);
+        if (b > 1) {
+            const uint32_t msb = 1u << (b - 1);
+            rc_encode_range(rc, f - msb, 1, msb);
+        }
+    }
+}
+
+void sm_read(struct range_coder* rc, struct static_model* sm) {
+    struct compact_model cm;
+    cm_init(&cm, sm_freq_bits);
+    uint32_t sum = 0;
+    for (size_t i = 0; i < rc_sym_count && rc->error == 0; i++) {
+        const uint8_t b = cm_decode(rc, &cm);
+        uint32_t f = b == 0 ? 0 : 1;
+        if (b >= sm_freq_bits) {
+            rc->error = rc_err_data;
+        } else if (b > 1) {
+            const uint32_t msb = 1u << (b - 1);
+            const uint64_t v = rc_decode_freq(rc, msb);
+            if (v >= msb) {
+                if (rc->error == 0) { rc->error = rc_err_data; }
+            } else {
+                rc_decode_range(rc, v, 1);
+                f = msb + (uint32_t)v;
+            }
+        }
+        sm->freq[i] = (uint16_t)f;
+        sum += f;
+    }
+    if (rc->error == 0 && sum != sm_total) { rc->error = rc_err_data; }
+    if (rc->error == 0) { sm_build(sm); }
+}
+
+void sm_encode_array(struct range_coder* rc, const struct static_model* sm,
+                     const uint8_t data[], size_t count) {
+    uint64_t low   = rc->low;
+    uint64_t range = rc->range;
+    size_t i = 0;
+    while (i < count) {
+        const uint8_t sym = data[i];
+        if (sm->freq[sym] == 0) { break; } // symbol is not in the model
+        if (range < sm_total) { // see rc_encode_range()
+            rc_out(rc, (uint8_t)(low >> 56)); low <<= 8;
+            rc_out(rc, (uint8_t)(low >> 56)); low <<= 8;
+            range = UINT64_MAX - low;
+        }
+        range >>= sm_bits;
+        low   += sm->start[sym] * range;
+        range *= sm->freq[sym];
+        while ((low >> 56) == ((low + range) >> 56)) {
+            rc_out(rc, (uint8_t)(low >> 56));
+            low <<= 8;
+            range <<= 8;
+        }
+        i++;
+    }
+    rc->low   = low;
+    rc->range = range;
+    if (i < count && rc->error == 0) { rc->error = rc_err_invalid; }
+}
+
+size_t sm_decode_array(struct range_coder* rc, const struct static_model* sm,
+                       uint8_t data[], size_t count) {
+    uint64_t low   = rc->low;
+    uint64_t range = rc->range;
+    uint64_t code  = rc->code;
+    size_t i = 0;
+    while (i < count) {
+        if (range < sm_total) {
+            code = (code << 8) + rc_in(rc); low <<= 8;
+            code = (code << 8) + rc_in(rc); low <<= 8;
+            range = UINT64_MAX - low;
+        }
+        range >>= sm_bits;
+        const uint64_t sum = (code - low) / range;
+        if (sum >= sm_total) { break; } // corrupted input
+        const uint8_t sym = sm->slot[sum];
+        low   += sm->start[sym] * range;
+        range *= sm->freq[sym];
+        while ((low >> 56) == ((low + range) >> 56)) {
+            code = (code << 8) + rc_in(rc);
+            low <<= 8;
+            range <<= 8;
+        }
+        data[i++] = sym;
+    }
+    rc->low   = low;
+    rc->range = range;
+    rc->code  = code;
+    if (i < count && rc->error == 0) { rc->error = rc_err_data; }
+    return i;
+}
+
+static const uint8_t rc_log2_fraction[64] = { // 16 * log2(1 + i / 64)
+     0,  0,  1,  1,  1,  2,  2,  2,  3,  3,  3,  4,  4,  4,  5,  5,
+     5,  5,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  8,  9,  9,  9,
+     9, 10, 10, 10, 10, 11, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13,
+    13, 13, 13, 14, 14, 14, 14, 14, 15, 15, 15, 15, 15, 15, 16, 16
+};
+
+static_assert(rc_price_bits == 4, "rc_log2_fraction[] is in 1/16 bit");
+
+static inline uint32_t rc_msb(uint64_t x) { // x != 0
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+        unsigned long i;
+        _BitScanReverse64(&i, x);
+        return (uint32_t)i;
+    #elif defined(_MSC_VER) // 32 bit: _BitScanReverse64() is x64/ARM64 only
+        unsigned long i;
+        if (x >> 32 != 0) {
+            _BitScanReverse(&i, (unsigned long)(x >> 32));
+            return (uint32_t)i + 32;
+        }
+        _BitScanReverse(&i, (unsigned long)x);
+        return (uint32_t)i;
+    #else
+        return 63 - (uint32_t)__builtin_clzll(x);
+    #endif
+}
+
+uint32_t rc_log2_price(uint64_t x) {
+    assert(x > 0);
+    const uint32_t e = rc_msb(x);
+    const uint64_t m = e >= 6 ? x >> (e - 6) : x << (6 - e); // 64..127
+    return (e << rc_price_bits) + rc_log2_fraction[m & 63];
+}
+
+uint64_t sm_entropy(const uint64_t histogram[rc_sym_count]) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < rc_sym_count; i++) { total += histogram[i]; }
+    uint64_t price = 0;
+    if (total > 0) {
+        const uint32_t log2_total = rc_log2_price(total);
+        for (size_t i = 0; i < rc_sym_count; i++) {
+            const uint64_t f = histogram[i];
+            if (f > 0) { price += f * (log2_total - rc_log2_price(f)); }
+        }
+    }
+    return price;
+}
+
+uint32_t pm_cost(const struct prob_model* pm, uint8_t sym) {
+    const uint64_t freq = pm->freq[sym];
+    if (freq == 0) { return rc_price_max; }
+    return rc_log2_price(pm->tree[countof(pm->tree) - 1]) -
+           rc_log2_price(freq);
+}
+
+void pm_prices(const struct prob_model* pm, struct price_table* pt) {
+    const uint32_t total = rc_log2_price(pm->tree[countof(pm->tree) - 1]);
+    for (size_t i = 0; i < countof(pt->cost); i++) {
+        const uint64_t freq = pm->freq[i];
+        pt->cost[i] = freq == 0 ? rc_price_max :
+                      total - rc_log2_price(freq);
+    }
+}
+
 #endif // rc_implementation
@@ -0,0 +1,143 @@
+#ifndef rc_binary_header_included
+#define rc_binary_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// Adaptive binary coder on top of struct range_coder
+//
+// Each binary decision has its own 12 bit probability of the bit
+// being 0 which is updated by a shift (no frequency tables). The
+// interval is split with a single multiplication (no division).
+// 8 bit symbols are coded as 8 binary decisions walking the bit tree
+// from the most significant bit (each tree node has own probability).
+//
+// The coder shares low/range/code and I/O with rc.h thus binary
+// decisions and rc_encode*()/rc_decode*() symbols can be freely mixed
+// in the same stream as long as decoder mirrors encoder order.
+//
+// rc_binary_implementation must be defined in the same compilation
+// unit as rc_implementation (it uses rc.h internal byte I/O).
+
+#include "rc.h"
+#include <stdbool.h>
+
+#define bc_prob_bits 12
+#define bc_prob_one  (1u << bc_prob_bits)
+#define bc_move_bits 5 // adaptation speed: 1/32 of the distance
+
+struct bit_tree { // 8 bit symbols, prob[1..255] are tree nodes
+    uint16_t prob[rc_sym_count];
+};
+
+void    bc_init(uint16_t prob[], size_t n); // all probabilities to 1/2
+void    bc_encode(struct range_coder* rc, uint16_t* prob, bool bit);
+bool    bc_decode(struct range_coder* rc, uint16_t* prob);
+
+// Binary decisions with probability p of the bit being 0
+// (0 < p < bc_prob_one) supplied by the caller (e.g. a mixer, see
+// rc_mix.h) without adaptation.
+
+void    bc_encode_bit(struct range_coder* rc, uint32_t p, bool bit);
+bool    bc_decode_bit(struct range_coder* rc, uint32_t p);
+
+void    bc_tree_init(struct bit_tree* bt);
+void    bc_tree_encode(struct range_coder* rc, struct bit_tree* bt,
+                       uint8_t sym);
+uint8_t bc_tree_decode(struct range_coder* rc, struct bit_tree* bt);
+
+#endif // rc_binary_header_included
+
+#if defined(rc_binary_implementation) && \
+   !defined(rc_binary_implementation_included)
+#define rc_binary_implementation_included // rc_mix.h includes rc_binary.h
+
+#ifndef rc_implementation
+#define rc_implementation
+#endif
+#include "rc.h"
+
+void bc_init(uint16_t prob[], size_t n) {
+    for (size_t i = 0; i < n; i++) { prob[i] = bc_prob_one / 2; }
+}
+
+void bc_encode_bit(struct range_coder* rc, uint32_t p, bool bit) {
+    assert(0 < p && p < bc_prob_one);
+    if (rc->range < bc_prob_one) { // see rc_encode_range()
+        rc_emit(rc);
+        rc_emit(rc);
+        rc->range = UINT64_MAX - rc->low;
+    }
+    const uint64_t bound = (rc->range >> bc_prob_bits) * p;
+    if (!bit) {
+        rc->range = bound;
+    } else {
+        rc->low   += bound;
+        rc->range -= bound;
+    }
+    while (rc_leftmost_byte_is_same(rc)) { rc_emit(rc); }
+}
+
+bool bc_decode_bit(struct range_coder* rc, uint32_t p) {
+    if (rc->range < bc_prob_one) {
+        rc_consume(rc);
+        rc_consume(rc);
+        rc->range = UINT64_MAX - rc->low;
+    }
+    const uint64_t bound = (rc->range >> bc_prob_bits) * p;
+    const bool bit = rc->code - rc->low >= bound;
+    if (!bit) {
+        rc->range = bound;
+    } else {
+        rc->low   += bound;
+        rc->range -= bound;
+    }
+    while (rc_leftmost_byte_is_same(rc)) { rc_consume(rc); }
+    return bit;
+}
+
+static inline void bc_update(uint16_t* prob, bool bit) {
+    const uint32_t p = *prob;
+    if (!bit) {
+        *prob = (uint16_t)(p + ((bc_prob_one - p) >> bc_move_bits));
+    } else {
+        *prob = (uint16_t)(p - (p >> bc_move_bits));
+    }
+}
+
+void bc_encode(struct range_coder* rc, uint16_t* prob, bool bit) {
+    bc_encode_bit(rc, *prob, bit);
+    bc_update(prob, bit);
+}
+
+bool bc_decode(struct range_coder* rc, uint16_t* prob) {
+    const bool bit = bc_decode_bit(rc, *prob);
+    bc_update(prob, bit);
+    return bit;
+}
+
+void bc_tree_init(struct bit_tree* bt) {
+    bc_init(bt->prob, countof(bt->prob));
+}
+
+void bc_tree_encode(struct range_coder* rc, struct bit_tree* bt,
+                    uint8_t sym) {
+    uint32_t node = 1;
+    for (int32_t i = rc_sym_bits - 1; i >= 0; i--) {
+        const uint32_t bit = (sym >> i) & 1;
+        bc_encode(rc, &bt->prob[node], bit);
+        node = (node << 1) | bit;
+    }
+}
+
+uint8_t bc_tree_decode(struct range_coder* rc, struct bit_tree* bt) {
+    uint32_t node = 1;
+    while (node < rc_sym_count) {
+        node = (node << 1) | bc_decode(rc, &bt->prob[node]);
+    }
+    return (uint8_t)(node - rc_sym_count);
+}
+
+#endif // rc_binary_implementation
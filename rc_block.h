@@ -0,0 +1,1046 @@
+#ifndef rc_block_header_included
+#define rc_block_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// Block parallel compression on top of rc.h
+//
+// Input is split into independent chunks. Each chunk is compressed
+// with its own range_coder and prob_model on a pool of threads and
+// resulting chunks are framed into a seekable container with the
+// trailing chunk index so decompression can fan out across cores
+// and rb_read() can decode any range of the original data touching
+// only the chunks it needs. rb_stream_*() produce and consume the
+// same frames incrementally in constant memory.
+//
+// Layout (all integers little endian):
+//   header: uint32_t magic "RCB1"
+//           uint8_t  version
+//           uint8_t  symbols - 1  // alphabet size 2..256
+//           uint16_t reserved
+//           uint64_t chunk        // uncompressed size of all but last chunk
+//   chunks * {
+//           uint32_t bytes        // uncompressed
+//           uint32_t compressed   // payload bytes that follow
+//           uint64_t checksum     // FNV-1a of uncompressed bytes
+//           uint8_t  method       // rb_method_*
+//           uint8_t  reserved[3]
+//           uint8_t  payload[compressed]
+//   }
+//   end:    chunk header with bytes = 0, method = rb_method_end,
+//           compressed = size of the index and footer that follow
+//           and checksum = total uncompressed bytes
+//   index:  chunks * { uint64_t offset; chunk header copy }
+//   footer: uint64_t index        // offset of the index
+//           uint32_t chunks       // index entries, 0 - no index
+//           uint32_t magic "RCB1"
+//
+// Chunk k covers original bytes [k * chunk .. k * chunk + bytes).
+// Streaming encoder cannot keep the index in constant memory and
+// writes frames without it. Readers locate chunks of such frames by
+// walking the chunk headers.
+//
+// rb_method_rans chunk payload: uint8_t states, ra_put_table() table
+// and ra_encode() data (see rc_rans.h). Chunks that rANS cannot fit in
+// the chunk bound fall back to rb_method_range.
+//
+// rb_method_lanes chunk payload: uint8_t lanes, ra_put_table() table
+// and ri_encode() data (see rc_interleave.h). Falls back the same way.
+//
+// rb_method_lz chunk payload: uint8_t window_bits and the range coder
+// stream of lz_encode() (see rc_lz.h). Falls back the same way.
+//
+// rb_method_stored chunk payload: uncompressed bytes verbatim. Chunks
+// are stored when the order 0 entropy estimate of the histogram
+// (sm_entropy() in rc.h) says that coding would not pay off (checked
+// before order 0 methods thus incompressible data is never coded
+// twice) or when the coded payload turns out to be not smaller than
+// the chunk. Decoder copies them.
+//
+// rc_block_implementation needs rc.h, rc_rans.h, rc_interleave.h and
+// rc_lz.h implementations.
+
+#include "rc.h"
+#include "rc_rans.h"
+#include "rc_interleave.h"
+#include "rc_lz.h"
+#include <stddef.h>
+
+#define rb_default_chunk (4u * 1024 * 1024)
+#define rb_max_chunk     (1u << 31)
+
+enum {
+    rb_method_range  = 0,   // adaptive order 0 range coder
+    rb_method_rans   = 1,   // static order 0 rANS table per chunk
+    rb_method_lanes  = 2,   // static order 0 interleaved range coder
+    rb_method_lz     = 3,   // LZ77 tokens with adaptive range coder
+    rb_method_stored = 4,   // incompressible chunk verbatim
+    rb_method_end    = 0xFF // end of chunks marker
+};
+
+struct rb_options {
+    size_t   chunk;   // uncompressed chunk size, 0 - rb_default_chunk
+    int32_t  threads; // number of threads, 0 - number of cores
+    uint32_t symbols; // alphabet size 2..256, 0 - 256
+    uint8_t  method;  // rb_method_range (default), _rans, _lanes or _lz
+    int32_t  level;   // rb_method_lz 1..9, 0 - lz_default_level
+};
+
+struct rb_info {
+    uint64_t bytes;   // total uncompressed size
+    uint64_t chunk;   // uncompressed chunk size (all but last chunk)
+    uint64_t index;   // offset of the chunk index
+    uint32_t chunks;  // number of chunks
+    uint32_t symbols; // alphabet size
+    bool     indexed; // false - chunk index is not present
+};
+
+int32_t rb_cores(void); // number of logical processors
+
+// rb_bound() - maximum compressed size of `bytes` of input
+
+size_t  rb_bound(size_t bytes, const struct rb_options* o);
+
+// return 0 or rc_err_* and number of bytes written to out[]
+
+int32_t rb_compress(const uint8_t in[], size_t bytes,
+                    uint8_t out[], size_t capacity, size_t *written,
+                    const struct rb_options* o);
+
+int32_t rb_decompress(const uint8_t in[], size_t bytes,
+                      uint8_t out[], size_t capacity, size_t *written,
+                      const struct rb_options* o);
+
+// rb_info() parses and validates header, footer and chunk index
+
+int32_t rb_info(const uint8_t in[], size_t bytes, struct rb_info* info);
+
+// rb_read() decodes original bytes [offset..offset + count)
+
+int32_t rb_read(const uint8_t in[], size_t bytes, uint64_t offset,
+                uint8_t out[], size_t count);
+
+// Streaming (zlib style) coding of the frames in constant memory:
+// one uncompressed chunk and one compressed chunk buffer.
+// Caller sets next_in/avail_in and next_out/avail_out and calls
+// rb_stream_encode()/rb_stream_decode() repeatedly. Each call consumes
+// as much input and produces as much output as possible and returns
+// 0 or rc_err_*. Encoder must be called with finish = true (providing
+// more output space if necessary) until `end` is set. Decoder sets
+// `end` when the whole frame has been decoded.
+
+struct rb_chunk {
+    const uint8_t* in;
+    size_t         bytes;
+    uint8_t*       out;
+    size_t         capacity;
+    size_t         written;
+    uint64_t       checksum; // of uncompressed data
+    uint32_t       symbols;
+    uint8_t        method;
+    int32_t        level;    // rb_method_lz
+    int32_t        error;
+};
+
+struct rb_stream {
+    const uint8_t* next_in;
+    size_t         avail_in;
+    uint8_t*       next_out;
+    size_t         avail_out;
+    uint64_t       total_in;
+    uint64_t       total_out;
+    bool           end;
+    // internal state:
+    struct rb_chunk c;
+    uint8_t*       chunk;    // uncompressed chunk
+    uint8_t*       frame;    // chunk header and compressed payload
+    uint8_t        head[32]; // decoder: frame, chunk header or footer
+    size_t         size;     // chunk size
+    size_t         bytes;    // collected in chunk[], frame[] or head[]
+    const uint8_t* pending;  // output not yet copied to next_out
+    size_t         left;     // number of pending bytes
+    uint64_t       length;   // uncompressed bytes so far
+    uint64_t       index;    // decoder: frame offset of the index
+    uint64_t       digest[2]; // decoder: FNV-1a of expected and read index
+    uint32_t       chunks;   // decoder: number of chunks so far
+    uint32_t       symbols;
+    uint8_t        method;   // requested for chunks
+    int32_t        level;    // rb_method_lz
+    int32_t        state;
+    int32_t        error;    // sticky
+};
+
+int32_t rb_stream_encoder(struct rb_stream* s, const struct rb_options* o);
+int32_t rb_stream_decoder(struct rb_stream* s);
+int32_t rb_stream_encode(struct rb_stream* s, bool finish);
+int32_t rb_stream_decode(struct rb_stream* s);
+void    rb_stream_fini(struct rb_stream* s);
+
+#endif // rc_block_header_included
+
+#ifdef rc_block_implementation
+
+#include "unstd.h"
+#include <threads.h>
+
+enum {
+    rb_magic        = 0x31424352, // "RCB1"
+    rb_version      = 1,
+    rb_header_size  = 16,
+    rb_chunk_header = 20,
+    rb_index_entry  = 8 + rb_chunk_header,
+    rb_footer_size  = 16
+};
+
+struct rb_job {
+    struct rb_chunk* chunk;
+    int32_t          count;
+    int32_t          next;  // next chunk to be processed
+    mtx_t            lock;
+    void (*process)(struct rb_chunk* c);
+};
+
+int32_t rb_cores(void) {
+    #ifdef _WIN32
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        return (int32_t)si.dwNumberOfProcessors;
+    #else
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return n > 0 ? (int32_t)n : 1;
+    #endif
+}
+
+static size_t rb_chunk_size(const struct rb_options* o) {
+    return o != null && o->chunk > 0 ? o->chunk : rb_default_chunk;
+}
+
+static uint32_t rb_symbols(const struct rb_options* o) {
+    return o != null && o->symbols > 0 ? o->symbols : rc_sym_count;
+}
+
+static int32_t rb_threads(const struct rb_options* o, int32_t chunks) {
+    int32_t n = o != null && o->threads > 0 ? o->threads : rb_cores();
+    return max(1, min(n, chunks));
+}
+
+static size_t rb_chunk_bound(size_t bytes) {
+    // adaptive order 0 model may expand data slightly (unseen symbols
+    // cost up to log2(total) bits) plus 8 bytes of rc_flush()
+    return bytes + bytes / 8 + 64;
+}
+
+size_t rb_bound(size_t bytes, const struct rb_options* o) {
+    const size_t chunk  = rb_chunk_size(o);
+    const size_t chunks = (bytes + chunk - 1) / chunk;
+    return rb_header_size + rb_chunk_header + rb_footer_size +
+           chunks * (rb_chunk_header + rb_index_entry) +
+           chunks * rb_chunk_bound(chunk);
+}
+
+static void rb_put32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) { p[i] = (uint8_t)(v >> (i * 8)); }
+}
+
+static void rb_put64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) { p[i] = (uint8_t)(v >> (i * 8)); }
+}
+
+static uint32_t rb_get32(const uint8_t* p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) { v = (v << 8) | p[i]; }
+    return v;
+}
+
+static uint64_t rb_get64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) { v = (v << 8) | p[i]; }
+    return v;
+}
+
+#define rb_fnv_basis 0xCBF29CE484222325uLL // FNV-1a offset basis
+
+static uint64_t rb_fnv(uint64_t h, const uint8_t* data, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        h ^= data[i];
+        h *= 0x100000001B3uLL; // FNV prime
+    }
+    return h;
+}
+
+static uint64_t rb_checksum(const uint8_t* data, size_t bytes) {
+    return rb_fnv(rb_fnv_basis, data, bytes);
+}
+
+static void rb_put_chunk_header(uint8_t* p, const struct rb_chunk* c) {
+    rb_put32(p, (uint32_t)c->bytes);
+    rb_put32(p + 4, (uint32_t)c->written);
+    rb_put64(p + 8, c->checksum);
+    p[16] = c->method;
+    p[17] = 0;
+    p[18] = 0;
+    p[19] = 0;
+}
+
+static void rb_put_header(uint8_t* p, uint32_t symbols, uint64_t chunk) {
+    rb_put32(p, rb_magic);
+    p[4] = rb_version;
+    p[5] = (uint8_t)(symbols - 1);
+    p[6] = 0;
+    p[7] = 0;
+    rb_put64(p + 8, chunk);
+}
+
+static void rb_put_end(uint8_t* p, uint64_t bytes, uint32_t entries) {
+    // end of chunks marker followed by the index and the footer
+    const struct rb_chunk end = {
+        .written  = (size_t)entries * rb_index_entry + rb_footer_size,
+        .checksum = bytes,
+        .method   = rb_method_end
+    };
+    rb_put_chunk_header(p, &end);
+}
+
+static void rb_put_footer(uint8_t* p, uint64_t index, uint32_t entries) {
+    rb_put64(p, index);
+    rb_put32(p + 8, entries);
+    rb_put32(p + 12, rb_magic);
+}
+
+static uint8_t rb_method(const struct rb_options* o) {
+    return o != null ? o->method : rb_method_range;
+}
+
+static int32_t rb_level(const struct rb_options* o) {
+    return o != null ? o->level : 0;
+}
+
+static bool rb_valid_method(uint8_t method) {
+    return method == rb_method_range || method == rb_method_rans ||
+           method == rb_method_lanes || method == rb_method_lz;
+}
+
+static bool rb_valid_level(int32_t level) {
+    return 0 <= level && level <= 9;
+}
+
+enum { rb_rans_states = 4, rb_lanes = 4 };
+
+static void rb_encode_static(struct rb_chunk* c, // rANS or lanes
+                             const uint64_t histogram[rc_sym_count]) {
+    struct static_model sm;
+    c->written = 0;
+    c->error = sm_init(&sm, histogram); // fails on empty chunk
+    if (c->error == 0 && c->capacity < 1 + ra_table_max) {
+        c->error = rc_err_no_space;
+    }
+    if (c->error == 0) {
+        const bool rans = c->method == rb_method_rans;
+        c->out[0] = rans ? rb_rans_states : rb_lanes;
+        const size_t table = 1 + ra_put_table(&sm, c->out + 1);
+        uint8_t* out = c->out + table;
+        const size_t capacity = c->capacity - table;
+        size_t k = 0;
+        c->error = rans ?
+            ra_encode(&sm, rb_rans_states, c->in, c->bytes,
+                      out, capacity, &k) :
+            ri_encode(&sm, rb_lanes, c->in, c->bytes, out, capacity, &k);
+        c->written = table + k;
+    }
+}
+
+static void rb_encode_lz(struct rb_chunk* c) {
+    // the window covers the whole chunk up to 4MB
+    uint32_t window = 10;
+    while (window < 22 && ((size_t)1 << window) < c->bytes) { window++; }
+    struct lz_model* lz = (struct lz_model*)malloc(sizeof(struct lz_model));
+    c->written = 0;
+    c->error = lz == null ? rc_err_no_memory : lz_init(lz, c->level, window);
+    if (c->error == 0 && c->capacity < 1) { c->error = rc_err_no_space; }
+    if (c->error == 0) {
+        struct range_coder rc = {0};
+        c->out[0] = (uint8_t)window;
+        rc_init(&rc, 0);
+        rc_span(&rc, c->out + 1, c->capacity - 1);
+        c->error = lz_encode(&rc, lz, c->in, c->bytes);
+        if (c->error == 0) {
+            rc_flush(&rc);
+            c->error = rc.error;
+        }
+        c->written = 1 + rc.next;
+    }
+    if (lz != null) { lz_fini(lz); }
+    free(lz);
+}
+
+static void rb_encode_range(struct rb_chunk* c) {
+    struct range_coder rc = {0};
+    struct prob_model  pm;
+    pm_init(&pm, c->symbols);
+    rc_init(&rc, 0);
+    rc_span(&rc, c->out, c->capacity);
+    rc_encode_array(&rc, &pm, c->in, c->bytes);
+    rc_flush(&rc);
+    c->written = rc.next;
+    c->error   = rc.error;
+}
+
+static bool rb_incompressible(const struct rb_chunk* c,
+                              const uint64_t histogram[rc_sym_count]) {
+    // order 0 entropy estimate of at least 7.875 bits per byte:
+    // order 0 coding would not pay off
+    const uint64_t bits = sm_entropy(histogram) >> rc_price_bits;
+    return bits >= c->bytes * 8 - c->bytes / 8;
+}
+
+static void rb_store(struct rb_chunk* c) {
+    memcpy(c->out, c->in, c->bytes); // rb_chunk_bound() > bytes
+    c->method  = rb_method_stored;
+    c->written = c->bytes;
+    c->error   = 0;
+}
+
+static void rb_encode(struct rb_chunk* c) {
+    // c->method is requested method on input and actual on output
+    c->checksum = rb_checksum(c->in, c->bytes);
+    // histogram preflight is shared by the estimate and static methods
+    uint64_t histogram[rc_sym_count] = {0};
+    if (c->method != rb_method_lz) {
+        sm_histogram(histogram, c->in, c->bytes);
+        if (rb_incompressible(c, histogram)) {
+            rb_store(c);
+            return;
+        }
+    }
+    if (c->method == rb_method_rans || c->method == rb_method_lanes) {
+        rb_encode_static(c, histogram);
+        if (c->error != 0) { // empty or incompressible chunk
+            c->method = rb_method_range;
+            c->error  = 0;
+        }
+    } else if (c->method == rb_method_lz) {
+        rb_encode_lz(c);
+        if (c->error != 0) { // incompressible chunk or out of memory
+            c->method = rb_method_range;
+            c->error  = 0;
+        }
+    }
+    if (c->method != rb_method_rans && c->method != rb_method_lanes &&
+        c->method != rb_method_lz) {
+        c->method = rb_method_range;
+        rb_encode_range(c);
+    }
+    if (c->error == 0 && c->written >= c->bytes) { rb_store(c); }
+}
+
+static void rb_decode_static(struct rb_chunk* c) { // rANS or lanes
+    struct static_model sm;
+    const size_t table = c->bytes < 1 ? 0 :
+                         ra_get_table(&sm, c->in + 1, c->bytes - 1);
+    const uint8_t* in = c->in + 1 + table;
+    const size_t bytes = c->bytes - 1 - table;
+    c->written = 0;
+    if (table == 0) {
+        c->error = rc_err_data;
+    } else if (c->method == rb_method_rans) {
+        c->error = ra_decode(&sm, c->in[0], in, bytes, c->out, c->capacity);
+    } else {
+        c->error = ri_decode(&sm, c->in[0], in, bytes, c->out, c->capacity);
+    }
+    if (c->error == 0) { c->written = c->capacity; }
+}
+
+static void rb_decode_lz(struct rb_chunk* c) {
+    struct lz_model* lz = (struct lz_model*)malloc(sizeof(struct lz_model));
+    c->written = 0;
+    if (lz == null) {
+        c->error = rc_err_no_memory;
+    } else if (c->bytes < 1 + sizeof(uint64_t) ||
+               lz_init(lz, 0, c->in[0]) != 0) {
+        c->error = rc_err_data;
+    } else {
+        struct range_coder rc = {0};
+        rc_span(&rc, (uint8_t*)c->in + 1, c->bytes - 1);
+        uint64_t code = 0;
+        for (size_t i = 0; i < sizeof(code); i++) {
+            code = (code << 8) + rc_in(&rc);
+        }
+        rc_init(&rc, code);
+        c->error = lz_decode(&rc, lz, c->out, c->capacity);
+        if (c->error == 0) { c->written = c->capacity; }
+    }
+    free(lz);
+}
+
+static void rb_decode_range(struct rb_chunk* c) {
+    struct range_coder rc = {0};
+    struct prob_model  pm;
+    pm_init(&pm, c->symbols);
+    rc_span(&rc, (uint8_t*)c->in, c->bytes);
+    uint64_t code = 0;
+    for (size_t i = 0; i < sizeof(code); i++) {
+        code = (code << 8) + rc_in(&rc);
+    }
+    rc_init(&rc, code);
+    rc.error = c->bytes < sizeof(code) ? rc_err_data : 0;
+    c->written = rc.error == 0 ?
+        rc_decode_array(&rc, &pm, c->out, c->capacity) : 0;
+    c->error = rc.error;
+}
+
+static void rb_decode_stored(struct rb_chunk* c) {
+    c->written = 0;
+    c->error = c->bytes == c->capacity ? 0 : rc_err_data;
+    if (c->error == 0) {
+        memcpy(c->out, c->in, c->bytes);
+        c->written = c->bytes;
+    }
+}
+
+static void rb_decode(struct rb_chunk* c) {
+    if (c->method == rb_method_range) {
+        rb_decode_range(c);
+    } else if (c->method == rb_method_rans || c->method == rb_method_lanes) {
+        rb_decode_static(c);
+    } else if (c->method == rb_method_lz) {
+        rb_decode_lz(c);
+    } else if (c->method == rb_method_stored) {
+        rb_decode_stored(c);
+    } else {
+        c->error = rc_err_unsupported;
+    }
+    if (c->error == 0 && rb_checksum(c->out, c->written) != c->checksum) {
+        c->error = rc_err_data;
+    }
+}
+
+static int rb_worker(void* p) {
+    struct rb_job* job = (struct rb_job*)p;
+    for (;;) {
+        mtx_lock(&job->lock);
+        const int32_t k = job->next++;
+        mtx_unlock(&job->lock);
+        if (k >= job->count) { break; }
+        job->process(&job->chunk[k]);
+    }
+    return 0;
+}
+
+static int32_t rb_run(struct rb_job* job, int32_t threads) {
+    // the calling thread is one of the workers
+    int32_t r = 0;
+    thrd_t  thread[64];
+    threads = min(threads, (int32_t)countof(thread));
+    job->next = 0;
+    if (mtx_init(&job->lock, mtx_plain) != thrd_success) {
+        return rc_err_no_memory;
+    }
+    int32_t started = 0;
+    for (int32_t i = 1; i < threads; i++) {
+        if (thrd_create(&thread[started], rb_worker, job) == thrd_success) {
+            started++;
+        }
+    }
+    rb_worker(job);
+    for (int32_t i = 0; i < started; i++) { thrd_join(thread[i], null); }
+    mtx_destroy(&job->lock);
+    for (int32_t i = 0; i < job->count && r == 0; i++) {
+        r = job->chunk[i].error;
+    }
+    return r;
+}
+
+int32_t rb_compress(const uint8_t in[], size_t bytes,
+                    uint8_t out[], size_t capacity, size_t *written,
+                    const struct rb_options* o) {
+    *written = 0;
+    const size_t   chunk   = rb_chunk_size(o);
+    const size_t   count   = (bytes + chunk - 1) / chunk;
+    const uint32_t symbols = rb_symbols(o);
+    if (chunk > rb_max_chunk) { return rc_err_invalid; }
+    if (symbols < 2 || symbols > rc_sym_count) { return rc_err_invalid; }
+    if (!rb_valid_method(rb_method(o))) { return rc_err_invalid; }
+    if (!rb_valid_level(rb_level(o))) { return rc_err_invalid; }
+    if (count > INT32_MAX / 2) { return rc_err_too_big; }
+    if (capacity < rb_bound(bytes, o)) { return rc_err_no_space; }
+    struct rb_chunk* c = (struct rb_chunk*)calloc(max(count, 1),
+                                                  sizeof(struct rb_chunk));
+    if (c == null) { return rc_err_no_memory; }
+    // each chunk is coded into its worst case slot and compacted after
+    uint8_t* slot = out + rb_header_size;
+    for (size_t i = 0; i < count; i++) {
+        c[i].in       = in + i * chunk;
+        c[i].bytes    = min(chunk, bytes - i * chunk);
+        c[i].out      = slot + rb_chunk_header;
+        c[i].capacity = rb_chunk_bound(c[i].bytes);
+        c[i].symbols  = symbols;
+        c[i].method   = rb_method(o);
+        c[i].level    = rb_level(o);
+        slot += rb_chunk_header + c[i].capacity;
+    }
+    struct rb_job job = { .chunk = c, .count = (int32_t)count,
+                          .process = rb_encode };
+    int32_t r = rb_run(&job, rb_threads(o, (int32_t)count));
+    if (r == 0) {
+        rb_put_header(out, symbols, chunk);
+        uint8_t* p = out + rb_header_size;
+        for (size_t i = 0; i < count; i++) {
+            memmove(p + rb_chunk_header, c[i].out, c[i].written);
+            rb_put_chunk_header(p, &c[i]);
+            c[i].out = p; // remember chunk offset for the index
+            p += rb_chunk_header + c[i].written;
+        }
+        rb_put_end(p, bytes, (uint32_t)count);
+        p += rb_chunk_header;
+        const uint64_t index = (uint64_t)(p - out);
+        for (size_t i = 0; i < count; i++) {
+            rb_put64(p, (uint64_t)(c[i].out - out));
+            rb_put_chunk_header(p + 8, &c[i]);
+            p += rb_index_entry;
+        }
+        rb_put_footer(p, index, (uint32_t)count);
+        p += rb_footer_size;
+        *written = (size_t)(p - out);
+    }
+    free(c);
+    return r;
+}
+
+int32_t rb_info(const uint8_t in[], size_t bytes, struct rb_info* info) {
+    memset(info, 0, sizeof(*info));
+    if (bytes < rb_header_size + rb_chunk_header + rb_footer_size) {
+        return rc_err_data;
+    }
+    const uint8_t* f = in + bytes - rb_footer_size;
+    if (rb_get32(in) != rb_magic || rb_get32(f + 12) != rb_magic) {
+        return rc_err_data;
+    }
+    if (in[4] != rb_version) { return rc_err_unsupported; }
+    info->symbols = in[5] + 1u;
+    info->chunk   = rb_get64(in + 8);
+    info->index   = rb_get64(f);
+    info->chunks  = rb_get32(f + 8);
+    info->indexed = info->chunks > 0;
+    const uint64_t end = bytes - rb_footer_size;
+    if (info->symbols < 2 || info->chunk == 0 ||
+        info->chunk > rb_max_chunk || info->chunks > INT32_MAX / 2 ||
+        info->index < rb_header_size + rb_chunk_header ||
+        info->index > end ||
+        (end - info->index) != (uint64_t)info->chunks * rb_index_entry) {
+        return rc_err_data;
+    }
+    const uint8_t* e = in + info->index - rb_chunk_header; // end marker
+    if (rb_get32(e) != 0 || e[16] != rb_method_end ||
+        rb_get32(e + 4) != bytes - info->index) {
+        return rc_err_data;
+    }
+    info->bytes = rb_get64(e + 8);
+    uint64_t total = 0;
+    if (info->indexed) {
+        const uint8_t* last = in + info->index +
+                              (info->chunks - 1) * (size_t)rb_index_entry;
+        const uint64_t n = rb_get32(last + 8);
+        if (n == 0 || n > info->chunk) { return rc_err_data; }
+        total = (info->chunks - 1) * info->chunk + n;
+    } else { // walk the chunk headers
+        const uint64_t limit = info->index - rb_chunk_header;
+        uint64_t offset = rb_header_size;
+        while (offset < limit) {
+            const uint8_t* h = in + offset;
+            if (limit - offset < rb_chunk_header) { return rc_err_data; }
+            const uint64_t n = rb_get32(h);
+            const uint64_t compressed = rb_get32(h + 4);
+            // only the last chunk can be shorter than info->chunk
+            if (n == 0 || n > info->chunk ||
+                total != info->chunks * info->chunk ||
+                compressed > limit - offset - rb_chunk_header ||
+                info->chunks == INT32_MAX / 2) {
+                return rc_err_data;
+            }
+            total += n;
+            info->chunks++;
+            offset += rb_chunk_header + compressed;
+        }
+    }
+    return total == info->bytes ? 0 : rc_err_data;
+}
+
+static int32_t rb_chunk_at(const uint8_t in[], const struct rb_info* info,
+                           uint64_t offset, uint32_t k, struct rb_chunk* c) {
+    // validates chunk `k` header at `offset` and sets up `c` to decode it
+    const uint64_t limit = info->index - rb_chunk_header; // end marker
+    if (offset < rb_header_size || offset > limit ||
+        limit - offset < rb_chunk_header) {
+        return rc_err_data;
+    }
+    const uint8_t* h = in + offset;
+    const uint64_t compressed = rb_get32(h + 4);
+    if (compressed > limit - offset - rb_chunk_header) { return rc_err_data; }
+    if (info->indexed) {
+        const uint8_t* e = in + info->index + k * (size_t)rb_index_entry;
+        if (rb_get64(e) != offset ||
+            memcmp(e + 8, h, rb_chunk_header) != 0) {
+            return rc_err_data;
+        }
+    }
+    c->in       = h + rb_chunk_header;
+    c->bytes    = (size_t)compressed;
+    c->capacity = rb_get32(h);
+    c->checksum = rb_get64(h + 8);
+    c->method   = h[16];
+    c->symbols  = info->symbols;
+    const uint64_t expected = k < info->chunks - 1 ? info->chunk :
+                              info->bytes - k * info->chunk;
+    return c->capacity == expected ? 0 : rc_err_data;
+}
+
+static uint64_t rb_offset_of(const uint8_t in[], const struct rb_info* info,
+                             uint32_t k) {
+    // offset of chunk `k` header (walk was validated by rb_info())
+    if (info->indexed) {
+        return rb_get64(in + info->index + k * (size_t)rb_index_entry);
+    }
+    uint64_t offset = rb_header_size;
+    for (uint32_t i = 0; i < k; i++) {
+        offset += rb_chunk_header + rb_get32(in + offset + 4);
+    }
+    return offset;
+}
+
+int32_t rb_decompress(const uint8_t in[], size_t bytes,
+                      uint8_t out[], size_t capacity, size_t *written,
+                      const struct rb_options* o) {
+    *written = 0;
+    struct rb_info info;
+    int32_t r = rb_info(in, bytes, &info);
+    if (r != 0) { return r; }
+    if (info.bytes > capacity) { return rc_err_no_space; }
+    struct rb_chunk* c = (struct rb_chunk*)calloc(max(info.chunks, 1),
+                                                  sizeof(struct rb_chunk));
+    if (c == null) { return rc_err_no_memory; }
+    uint64_t offset = rb_header_size;
+    for (uint32_t i = 0; i < info.chunks && r == 0; i++) {
+        r = rb_chunk_at(in, &info, offset, i, &c[i]);
+        c[i].out = out + i * info.chunk;
+        offset += rb_chunk_header + c[i].bytes;
+    }
+    if (r == 0 && offset != info.index - rb_chunk_header) {
+        r = rc_err_data; // chunks must be followed by the end marker
+    }
+    if (r == 0) {
+        struct rb_job job = { .chunk = c, .count = (int32_t)info.chunks,
+                              .process = rb_decode };
+        r = rb_run(&job, rb_threads(o, (int32_t)info.chunks));
+    }
+    if (r == 0) { *written = (size_t)info.bytes; }
+    free(c);
+    return r;
+}
+
+int32_t rb_read(const uint8_t in[], size_t bytes, uint64_t offset,
+                uint8_t out[], size_t count) {
+    struct rb_info info;
+    int32_t r = rb_info(in, bytes, &info);
+    if (r != 0) { return r; }
+    if (offset > info.bytes || count > info.bytes - offset) {
+        return rc_err_range;
+    }
+    uint8_t* scratch = null; // for partially requested chunks
+    uint64_t k = count > 0 ? offset / info.chunk : info.chunks;
+    uint64_t at = k < info.chunks ?
+                  rb_offset_of(in, &info, (uint32_t)k) : 0;
+    while (r == 0 && count > 0) {
+        struct rb_chunk c = {0};
+        r = rb_chunk_at(in, &info, at, (uint32_t)k, &c);
+        const uint64_t start = k * info.chunk;
+        const size_t   skip  = (size_t)(offset - start);
+        const size_t   n     = min(count, c.capacity - skip);
+        if (r == 0 && n == c.capacity) {
+            c.out = out;
+        } else if (r == 0) {
+            if (scratch == null) { scratch = (uint8_t*)malloc(info.chunk); }
+            if (scratch == null) { r = rc_err_no_memory; }
+            c.out = scratch;
+        }
+        if (r == 0) {
+            rb_decode(&c);
+            r = c.error;
+        }
+        if (r == 0) {
+            if (c.out != out) { memcpy(out, scratch + skip, n); }
+            out    += n;
+            offset += n;
+            count  -= n;
+            at     += rb_chunk_header + c.bytes;
+            k++;
+        }
+    }
+    free(scratch);
+    return r;
+}
+
+enum { // rb_stream.state
+    rb_stream_header  = 0, // decoder: frame header
+    rb_stream_chunk   = 1, // chunk header (encoder: chunk data)
+    rb_stream_payload = 2, // decoder: compressed payload
+    rb_stream_trailer = 3  // end marker, index and footer
+};
+
+static int32_t rb_stream_alloc(struct rb_stream* s) {
+    s->chunk = (uint8_t*)malloc(s->size);
+    s->frame = (uint8_t*)malloc(rb_chunk_header + rb_chunk_bound(s->size));
+    return s->chunk != null && s->frame != null ? 0 : rc_err_no_memory;
+}
+
+void rb_stream_fini(struct rb_stream* s) {
+    free(s->chunk);
+    free(s->frame);
+    s->chunk = null;
+    s->frame = null;
+}
+
+static void rb_stream_drain(struct rb_stream* s) {
+    const size_t n = min(s->left, s->avail_out);
+    memcpy(s->next_out, s->pending, n);
+    s->next_out  += n;
+    s->avail_out -= n;
+    s->total_out += n;
+    s->pending   += n;
+    s->left      -= n;
+}
+
+static void rb_stream_consume(struct rb_stream* s, size_t n) {
+    s->next_in  += n;
+    s->avail_in -= n;
+    s->total_in += n;
+}
+
+int32_t rb_stream_encoder(struct rb_stream* s, const struct rb_options* o) {
+    memset(s, 0, sizeof(*s));
+    s->size    = rb_chunk_size(o);
+    s->symbols = rb_symbols(o);
+    s->method  = rb_method(o);
+    s->level   = rb_level(o);
+    if (s->size > rb_max_chunk || s->symbols < 2 ||
+        s->symbols > rc_sym_count || !rb_valid_method(s->method) ||
+        !rb_valid_level(s->level)) {
+        return rc_err_invalid;
+    }
+    s->error = rb_stream_alloc(s);
+    if (s->error == 0) {
+        rb_put_header(s->frame, s->symbols, s->size);
+        s->pending = s->frame;
+        s->left    = rb_header_size;
+        s->state   = rb_stream_chunk;
+    }
+    return s->error;
+}
+
+static void rb_stream_compress(struct rb_stream* s, const uint8_t* data,
+                               size_t bytes) {
+    struct rb_chunk* c = &s->c;
+    memset(c, 0, sizeof(*c));
+    c->in       = data;
+    c->bytes    = bytes;
+    c->out      = s->frame + rb_chunk_header;
+    c->capacity = rb_chunk_bound(bytes);
+    c->symbols  = s->symbols;
+    c->method   = s->method;
+    c->level    = s->level;
+    rb_encode(c);
+    s->error = c->error;
+    rb_put_chunk_header(s->frame, c);
+    s->pending = s->frame;
+    s->left    = rb_chunk_header + c->written;
+    s->length += bytes;
+}
+
+int32_t rb_stream_encode(struct rb_stream* s, bool finish) {
+    while (s->error == 0 && !s->end) {
+        if (s->left > 0) {
+            rb_stream_drain(s);
+            if (s->left > 0) { break; } // no output space
+        } else if (s->state == rb_stream_trailer) {
+            s->end = true;
+        } else if (s->bytes == 0 && s->avail_in >= s->size) {
+            rb_stream_compress(s, s->next_in, s->size); // without copying
+            rb_stream_consume(s, s->size);
+        } else if (s->avail_in > 0) {
+            const size_t n = min(s->avail_in, s->size - s->bytes);
+            memcpy(s->chunk + s->bytes, s->next_in, n);
+            rb_stream_consume(s, n);
+            s->bytes += n;
+            if (s->bytes == s->size) {
+                rb_stream_compress(s, s->chunk, s->bytes);
+                s->bytes = 0;
+            }
+        } else if (!finish) {
+            break; // need more input
+        } else if (s->bytes > 0) {
+            rb_stream_compress(s, s->chunk, s->bytes);
+            s->bytes = 0;
+        } else { // end marker and footer without the index
+            rb_put_end(s->frame, s->length, 0);
+            rb_put_footer(s->frame + rb_chunk_header,
+                          s->total_out + rb_chunk_header, 0);
+            s->pending = s->frame;
+            s->left    = rb_chunk_header + rb_footer_size;
+            s->state   = rb_stream_trailer;
+        }
+    }
+    return s->error;
+}
+
+int32_t rb_stream_decoder(struct rb_stream* s) {
+    memset(s, 0, sizeof(*s));
+    s->state = rb_stream_header;
+    s->digest[0] = rb_fnv_basis;
+    s->digest[1] = rb_fnv_basis;
+    return 0;
+}
+
+static bool rb_stream_collect(struct rb_stream* s, uint8_t* to, size_t n) {
+    // collects `n` bytes of input in to[] returns true when done
+    const size_t k = min(s->avail_in, n - s->bytes);
+    memcpy(to + s->bytes, s->next_in, k);
+    rb_stream_consume(s, k);
+    s->bytes += k;
+    return s->bytes == n;
+}
+
+static int32_t rb_stream_header_in(struct rb_stream* s) {
+    const uint8_t* h = s->head;
+    if (rb_get32(h) != rb_magic) { return rc_err_data; }
+    if (h[4] != rb_version) { return rc_err_unsupported; }
+    s->symbols = h[5] + 1u;
+    const uint64_t chunk = rb_get64(h + 8);
+    if (s->symbols < 2 || chunk == 0 || chunk > rb_max_chunk) {
+        return rc_err_data;
+    }
+    s->size = (size_t)chunk;
+    return rb_stream_alloc(s);
+}
+
+static int32_t rb_stream_chunk_in(struct rb_stream* s) {
+    const uint8_t* h = s->head;
+    struct rb_chunk* c = &s->c;
+    memset(c, 0, sizeof(*c));
+    c->capacity = rb_get32(h);
+    c->bytes    = rb_get32(h + 4);
+    c->checksum = rb_get64(h + 8);
+    c->method   = h[16];
+    c->symbols  = s->symbols;
+    if (c->method == rb_method_end) {
+        s->state = rb_stream_trailer;
+        s->index = s->total_in;
+        return c->capacity == 0 && c->checksum == s->length &&
+               c->bytes >= rb_footer_size ? 0 : rc_err_data;
+    } else {
+        // index entry expected for this chunk: offset and header copy
+        uint8_t e[rb_index_entry];
+        rb_put64(e, s->total_in - rb_chunk_header);
+        memcpy(e + 8, h, rb_chunk_header);
+        s->digest[0] = rb_fnv(s->digest[0], e, sizeof(e));
+        s->chunks++;
+        s->state = rb_stream_payload;
+        // only the last chunk can be shorter than s->size
+        return c->capacity > 0 && c->capacity <= s->size &&
+               s->length % s->size == 0 && s->chunks < INT32_MAX / 2 &&
+               c->bytes <= rb_chunk_bound(s->size) ? 0 : rc_err_data;
+    }
+}
+
+static int32_t rb_stream_footer_in(struct rb_stream* s, size_t n) {
+    // footer in s->head, `n` index bytes were skipped: stream encoder
+    // writes no index, otherwise it must match the decoded chunks
+    const uint64_t index   = rb_get64(s->head);
+    const uint32_t entries = rb_get32(s->head + 8);
+    if (rb_get32(s->head + 12) != rb_magic || index != s->index) {
+        return rc_err_data;
+    } else if (entries == 0) {
+        return n == 0 ? 0 : rc_err_data;
+    } else {
+        return entries == s->chunks &&
+               n == (size_t)entries * rb_index_entry &&
+               s->digest[0] == s->digest[1] ? 0 : rc_err_data;
+    }
+}
+
+static void rb_stream_decompress(struct rb_stream* s, const uint8_t* in) {
+    struct rb_chunk* c = &s->c;
+    const bool direct = s->avail_out >= c->capacity;
+    c->in  = in;
+    c->out = direct ? s->next_out : s->chunk;
+    rb_decode(c);
+    s->error = c->error;
+    if (s->error == 0 && direct) {
+        s->next_out  += c->capacity;
+        s->avail_out -= c->capacity;
+        s->total_out += c->capacity;
+    } else if (s->error == 0) {
+        s->pending = s->chunk;
+        s->left    = c->capacity;
+    }
+    s->length += c->capacity;
+    s->state = rb_stream_chunk;
+}
+
+int32_t rb_stream_decode(struct rb_stream* s) {
+    bool more = true; // progress is possible
+    while (s->error == 0 && !s->end && more) {
+        if (s->left > 0) {
+            rb_stream_drain(s);
+            more = s->left == 0;
+        } else if (s->state == rb_stream_header) {
+            more = rb_stream_collect(s, s->head, rb_header_size);
+            if (more) {
+                s->bytes = 0;
+                s->error = rb_stream_header_in(s);
+                s->state = rb_stream_chunk;
+            }
+        } else if (s->state == rb_stream_chunk) {
+            more = rb_stream_collect(s, s->head, rb_chunk_header);
+            if (more) {
+                s->bytes = 0;
+                s->error = rb_stream_chunk_in(s);
+            }
+        } else if (s->state == rb_stream_payload) {
+            if (s->bytes == 0 && s->avail_in >= s->c.bytes) {
+                const uint8_t* in = s->next_in; // without copying
+                rb_stream_consume(s, s->c.bytes);
+                rb_stream_decompress(s, in);
+            } else {
+                more = rb_stream_collect(s, s->frame, s->c.bytes);
+                if (more) {
+                    s->bytes = 0;
+                    rb_stream_decompress(s, s->frame);
+                }
+            }
+        } else { // rb_stream_trailer: skip the index, check the footer
+            const size_t n = s->c.bytes - rb_footer_size; // index bytes
+            if (s->bytes < n) {
+                const size_t k = min(s->avail_in, n - s->bytes);
+                s->digest[1] = rb_fnv(s->digest[1], s->next_in, k);
+                rb_stream_consume(s, k);
+                s->bytes += k;
+                more = s->bytes == n;
+            } else {
+                const size_t k = min(s->avail_in, s->c.bytes - s->bytes);
+                memcpy(s->head + (s->bytes - n), s->next_in, k);
+                rb_stream_consume(s, k);
+                s->bytes += k;
+                more = s->bytes == s->c.bytes;
+                if (more) {
+                    s->end = true;
+                    s->error = rb_stream_footer_in(s, n);
+                }
+            }
+        }
+    }
+    return s->error;
+}
+
+#endif // rc_block_implementation
@@ -0,0 +1,165 @@
+#ifndef rc_context_header_included
+#define rc_context_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// Order-1 and order-2 context models
+//
+// Symbol probabilities are conditioned on the previous one (order-1)
+// or two (order-2) bytes. Each byte is coded as two nibbles with 16
+// symbol adaptive models: the high nibble in the context of the
+// previous bytes and the low nibble in the context of the previous
+// bytes and the high nibble. A context slot is 17 nibble models of
+// 34 bytes (578 bytes) instead of 4KB of prob_model thus order-1 takes
+// 148KB. Order-2 contexts are hashed into 1 << bits slots
+// (bits = 16 is exact and takes 37MB, cx_default_bits takes 2.3MB).
+//
+// Order-0 (single slot) is supported for comparison. Encoder and
+// decoder must use the same order and bits. Coding uses
+// rc_encode_range()/rc_decode_freq()/rc_decode_range() thus context
+// symbols can be mixed with other models in the same stream.
+
+#include "rc.h"
+
+#define cx_nibble        16 // symbols of a nibble model
+#define cx_default_bits  12 // order-2 hash table slots 1 << bits
+#define cx_inc           24 // frequency increment of the coded nibble
+#define cx_limit   (1u << 13) // total that triggers halving rescale
+
+struct nibble_model {
+    uint16_t freq[cx_nibble];
+    uint16_t total;
+};
+
+struct context_model {
+    uint32_t order;   // 0, 1 or 2 previous bytes
+    uint32_t bits;    // log2 of the number of context slots
+    uint32_t history; // previous bytes, most recent in bits 0..7
+    struct nibble_model* nm; // (1 << bits) * (1 + cx_nibble) models
+};
+
+// cx_init() allocates models and returns rc_err_no_memory on failure
+// or rc_err_invalid for order > 2. `bits` is only used by order-2
+// (1..16, 0 - cx_default_bits). cx_reset() restores initial state
+// of initialized model (e.g. for the next block).
+
+int32_t cx_init(struct context_model* cx, uint32_t order, uint32_t bits);
+void    cx_reset(struct context_model* cx);
+void    cx_fini(struct context_model* cx);
+size_t  cx_memory(const struct context_model* cx); // bytes allocated
+void    cx_encode(struct range_coder* rc, struct context_model* cx,
+                  uint8_t sym);
+uint8_t cx_decode(struct range_coder* rc, struct context_model* cx);
+
+#endif // rc_context_header_included
+
+#ifdef rc_context_implementation
+
+#include "unstd.h"
+
+static void cx_nibble_init(struct nibble_model* nm) {
+    for (int32_t i = 0; i < cx_nibble; i++) { nm->freq[i] = 1; }
+    nm->total = cx_nibble;
+}
+
+static void cx_update(struct nibble_model* nm, uint32_t sym) {
+    nm->freq[sym] += cx_inc;
+    nm->total += cx_inc;
+    if (nm->total > cx_limit) { // halve keeping frequencies non zero
+        uint32_t total = 0;
+        for (int32_t i = 0; i < cx_nibble; i++) {
+            nm->freq[i] = (uint16_t)((nm->freq[i] + 1) / 2);
+            total += nm->freq[i];
+        }
+        nm->total = (uint16_t)total;
+    }
+}
+
+static void cx_encode_nibble(struct range_coder* rc, struct nibble_model* nm,
+                             uint32_t sym) {
+    uint32_t start = 0;
+    for (uint32_t i = 0; i < sym; i++) { start += nm->freq[i]; }
+    rc_encode_range(rc, start, nm->freq[sym], nm->total);
+    cx_update(nm, sym);
+}
+
+static uint32_t cx_decode_nibble(struct range_coder* rc,
+                                 struct nibble_model* nm) {
+    const uint64_t sum = rc_decode_freq(rc, nm->total);
+    if (sum >= nm->total) {
+        if (rc->error == 0) { rc->error = rc_err_data; }
+        return 0;
+    }
+    uint32_t sym = 0;
+    uint32_t start = 0;
+    while (start + nm->freq[sym] <= sum) { start += nm->freq[sym++]; }
+    rc_decode_range(rc, start, nm->freq[sym]);
+    cx_update(nm, sym);
+    return sym;
+}
+
+static struct nibble_model* cx_slot(struct context_model* cx) {
+    uint32_t slot = 0;
+    if (cx->order == 1) {
+        slot = cx->history & 0xFF;
+    } else if (cx->order == 2 && cx->bits >= 16) {
+        slot = cx->history & 0xFFFF;
+    } else if (cx->order == 2) { // Fibonacci hashing
+        slot = ((cx->history & 0xFFFF) * 0x9E3779B1u) >> (32 - cx->bits);
+    }
+    return cx->nm + (size_t)slot * (1 + cx_nibble);
+}
+
+static uint32_t cx_slots(const struct context_model* cx) {
+    return cx->order == 0 ? 1 : (1u << cx->bits);
+}
+
+int32_t cx_init(struct context_model* cx, uint32_t order, uint32_t bits) {
+    memset(cx, 0, sizeof(*cx));
+    if (order > 2 || (order == 2 && bits > 16)) { return rc_err_invalid; }
+    cx->order = order;
+    cx->bits  = order == 1 ? 8 : (order == 2 ? bits : 0);
+    if (order == 2 && bits == 0) { cx->bits = cx_default_bits; }
+    cx->nm = (struct nibble_model*)malloc(cx_memory(cx));
+    if (cx->nm == null) { return rc_err_no_memory; }
+    cx_reset(cx);
+    return 0;
+}
+
+void cx_reset(struct context_model* cx) {
+    const size_t n = (size_t)cx_slots(cx) * (1 + cx_nibble);
+    for (size_t i = 0; i < n; i++) { cx_nibble_init(&cx->nm[i]); }
+    cx->history = 0;
+}
+
+void cx_fini(struct context_model* cx) {
+    free(cx->nm);
+    cx->nm = null;
+}
+
+size_t cx_memory(const struct context_model* cx) {
+    return (size_t)cx_slots(cx) * (1 + cx_nibble) *
+           sizeof(struct nibble_model);
+}
+
+void cx_encode(struct range_coder* rc, struct context_model* cx,
+               uint8_t sym) {
+    struct nibble_model* nm = cx_slot(cx);
+    cx_encode_nibble(rc, &nm[0], sym >> 4);
+    cx_encode_nibble(rc, &nm[1 + (sym >> 4)], sym & 0xF);
+    cx->history = (cx->history << 8) | sym;
+}
+
+uint8_t cx_decode(struct range_coder* rc, struct context_model* cx) {
+    struct nibble_model* nm = cx_slot(cx);
+    const uint32_t hi = cx_decode_nibble(rc, &nm[0]);
+    const uint32_t lo = cx_decode_nibble(rc, &nm[1 + hi]);
+    const uint8_t sym = (uint8_t)((hi << 4) | lo);
+    cx->history = (cx->history << 8) | sym;
+    return sym;
+}
+
+#endif // rc_context_implementation
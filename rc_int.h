@@ -0,0 +1,164 @@
+#ifndef rc_int_header_included
+#define rc_int_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// Integer stream codec for 16, 32 and 64 bit fields
+//
+// Each value is split into the bucket (bit length 0..64, the position
+// of the leading 1 bit) coded with an adaptive compact_model in the
+// context of the previous bucket, and the mantissa (bits below the
+// leading 1) sent raw with rc_encode_bits(). Small values cost a few
+// bits and large values cost their magnitude instead of one model per
+// byte plane.
+//
+// Optional transforms before coding (all modulo 2^64 thus any uint64_t
+// values round trip and 16/32 bit fields can be cast):
+//   ic_raw     value as is
+//   ic_zigzag  signed value: 0, -1, 1, -2, 2 ... -> 0, 1, 2, 3, 4 ...
+//   ic_delta   zigzag of the difference with the previous value
+//              (counters, sorted offsets, timestamps)
+//   ic_delta2  zigzag of delta of delta (regular timestamps)
+//
+// Encoder and decoder must use the same transform. Coding uses
+// rc_encode_range()/rc_decode_freq()/rc_decode_range() and
+// rc_encode_bits()/rc_decode_bits() thus integers can be mixed with
+// other models in the same stream.
+
+#include "rc.h"
+
+enum {
+    ic_raw    = 0,
+    ic_zigzag = 1,
+    ic_delta  = 2,
+    ic_delta2 = 3
+};
+
+#define ic_buckets  65 // bit lengths 0..64
+#define ic_contexts 9  // previous bucket / 8
+
+struct int_model {
+    struct compact_model bucket[ic_contexts];
+    uint64_t previous;  // value
+    uint64_t delta;     // previous delta (ic_delta2)
+    uint32_t context;   // of the next bucket
+    uint32_t transform; // ic_raw, ic_zigzag, ic_delta or ic_delta2
+};
+
+// ic_init() returns rc_err_invalid for unknown transform.
+// ic_reset() restores initial state (e.g. for the next block).
+
+int32_t  ic_init(struct int_model* im, uint32_t transform);
+void     ic_reset(struct int_model* im);
+void     ic_encode(struct range_coder* rc, struct int_model* im, uint64_t v);
+uint64_t ic_decode(struct range_coder* rc, struct int_model* im);
+
+#endif // rc_int_header_included
+
+#if defined(rc_int_implementation) && \
+   !defined(rc_int_implementation_included)
+#define rc_int_implementation_included // rc_run.h includes rc_int.h
+
+#include "unstd.h"
+
+// Mantissa bits per rc_encode_bits(). Streams written with the
+// earlier 16 bit chunks (rc_encode_range() with total 1 << 16) do
+// not decode with 32 bit chunks: range scaling rounds differently.
+enum { ic_raw_bits = 32 };
+
+int32_t ic_init(struct int_model* im, uint32_t transform) {
+    memset(im, 0, sizeof(*im));
+    if (transform > ic_delta2) { return rc_err_invalid; }
+    im->transform = transform;
+    ic_reset(im);
+    return 0;
+}
+
+void ic_reset(struct int_model* im) {
+    for (size_t i = 0; i < countof(im->bucket); i++) {
+        cm_init(&im->bucket[i], ic_buckets);
+    }
+    im->previous = 0;
+    im->delta    = 0;
+    im->context  = 0;
+}
+
+static inline uint64_t ic_zigzag_of(uint64_t v) { // v is int64_t
+    return (v << 1) ^ (0 - (v >> 63));
+}
+
+static inline uint64_t ic_unzigzag(uint64_t z) {
+    return (z >> 1) ^ (0 - (z & 1));
+}
+
+static uint64_t ic_forward(struct int_model* im, uint64_t v) {
+    uint64_t z = v;
+    if (im->transform == ic_zigzag) {
+        z = ic_zigzag_of(v);
+    } else if (im->transform == ic_delta) {
+        z = ic_zigzag_of(v - im->previous);
+    } else if (im->transform == ic_delta2) {
+        const uint64_t d = v - im->previous;
+        z = ic_zigzag_of(d - im->delta);
+        im->delta = d;
+    }
+    im->previous = v;
+    return z;
+}
+
+static uint64_t ic_inverse(struct int_model* im, uint64_t z) {
+    uint64_t v = z;
+    if (im->transform == ic_zigzag) {
+        v = ic_unzigzag(z);
+    } else if (im->transform == ic_delta) {
+        v = im->previous + ic_unzigzag(z);
+    } else if (im->transform == ic_delta2) {
+        im->delta += ic_unzigzag(z);
+        v = im->previous + im->delta;
+    }
+    im->previous = v;
+    return v;
+}
+
+static uint32_t ic_bucket(uint64_t z) { // bit length of z
+    uint32_t e = 0;
+    while (e < 64 && (z >> e) != 0) { e++; }
+    return e;
+}
+
+void ic_encode(struct range_coder* rc, struct int_model* im, uint64_t v) {
+    const uint64_t z = ic_forward(im, v);
+    const uint32_t e = ic_bucket(z);
+    cm_encode(rc, &im->bucket[im->context], (uint8_t)e);
+    im->context = e / 8;
+    uint32_t bits = e > 1 ? e - 1 : 0; // mantissa below the leading 1
+    while (bits > 0) {
+        const uint32_t k = min(bits, (uint32_t)ic_raw_bits);
+        bits -= k;
+        const uint64_t m = (z >> bits) & ((1uLL << k) - 1);
+        rc_encode_bits(rc, (uint32_t)m, k);
+    }
+}
+
+uint64_t ic_decode(struct range_coder* rc, struct int_model* im) {
+    const uint32_t e = cm_decode(rc, &im->bucket[im->context]);
+    if (e >= ic_buckets) {
+        if (rc->error == 0) { rc->error = rc_err_data; }
+        return 0;
+    }
+    im->context = e / 8;
+    uint64_t z = e > 0 ? 1 : 0;
+    uint32_t bits = e > 1 ? e - 1 : 0;
+    while (bits > 0) {
+        const uint32_t k = min(bits, (uint32_t)ic_raw_bits);
+        bits -= k;
+        z = (z << k) | rc_decode_bits(rc, k);
+        if (rc->error != 0) { return 0; }
+    }
+    return ic_inverse(im, z);
+}
+
+#endif // rc_int_implementation
@@ -0,0 +1,206 @@
+#ifndef rc_interleave_header_included
+#define rc_interleave_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// Interleaved range coding of a single stream
+//
+// 1, 2, 4 or 8 independent range coder lanes (the same 64 bit carry-less
+// coder as sm_encode_array()) take symbols round robin: symbol i is
+// coded by lane i % lanes. Dependency chains (divide, multiply, compare,
+// emit) of different lanes do not depend on each other thus the CPU
+// overlaps them.
+//
+// Stream layout is defined by the decoder consumption order:
+//   8 bytes of initial code of lane 0, lane 1, ... lane - 1 (big endian)
+//   followed by one byte for every byte a lane consumes while decoding
+//   symbols, in order of symbols (and of the bytes within a symbol).
+// Encoder emits bytes 8 positions ahead of the decoder in each lane and
+// places each emitted byte into the stream slot that lane reserved when
+// it emitted 8 bytes earlier. Final flush of 8 bytes per lane fills the
+// remaining reserved slots. With lanes = 1 the stream is bit identical
+// to sm_encode_array() followed by the flush of the range coder.
+
+#include "rc.h"
+
+#define ri_max_lanes 8
+
+int32_t ri_encode(const struct static_model* sm, int32_t lanes,
+                  const uint8_t in[], size_t count,
+                  uint8_t out[], size_t capacity, size_t* written);
+int32_t ri_decode(const struct static_model* sm, int32_t lanes,
+                  const uint8_t in[], size_t bytes,
+                  uint8_t out[], size_t count);
+
+#endif // rc_interleave_header_included
+
+#ifdef rc_interleave_implementation
+
+#include "unstd.h"
+
+enum {
+    ri_code_bytes = 8, // sizeof(uint64_t) of initial code and flush
+    ri_symbol_max = 10 // bytes per symbol: 2 underflow + normalization
+};
+
+struct ri_lane { // encoder
+    uint64_t low;
+    uint64_t range;
+    size_t   slot[ri_code_bytes]; // reserved stream positions (ring)
+    uint32_t head; // oldest reserved slot
+};
+
+static bool ri_valid_lanes(int32_t lanes) {
+    return lanes == 1 || lanes == 2 || lanes == 4 || lanes == 8;
+}
+
+static inline void ri_emit(struct ri_lane* l, uint8_t out[], size_t* next,
+                           bool reserve) {
+    out[l->slot[l->head]] = (uint8_t)(l->low >> 56);
+    l->low <<= 8;
+    if (reserve) { l->slot[l->head] = (*next)++; }
+    l->head = (l->head + 1) % ri_code_bytes;
+}
+
+int32_t ri_encode(const struct static_model* sm, int32_t lanes,
+                  const uint8_t in[], size_t count,
+                  uint8_t out[], size_t capacity, size_t* written) {
+    *written = 0;
+    if (!ri_valid_lanes(lanes)) { return rc_err_invalid; }
+    const size_t n = (size_t)lanes;
+    if (capacity < n * ri_code_bytes) { return rc_err_no_space; }
+    struct ri_lane lane[ri_max_lanes];
+    for (size_t j = 0; j < n; j++) {
+        lane[j].low   = 0;
+        lane[j].range = UINT64_MAX;
+        lane[j].head  = 0;
+        for (size_t k = 0; k < ri_code_bytes; k++) {
+            lane[j].slot[k] = j * ri_code_bytes + k;
+        }
+    }
+    size_t next = n * ri_code_bytes; // next not yet reserved position
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t sym = in[i];
+        if (sm->freq[sym] == 0) { return rc_err_invalid; } // not in model
+        if (capacity - next < ri_symbol_max) { return rc_err_no_space; }
+        struct ri_lane* l = &lane[i & (n - 1)];
+        if (l->range < sm_total) { // see rc_encode_range()
+            ri_emit(l, out, &next, true);
+            ri_emit(l, out, &next, true);
+            l->range = UINT64_MAX - l->low;
+        }
+        l->range >>= sm_bits;
+        l->low   += sm->start[sym] * l->range;
+        l->range *= sm->freq[sym];
+        while ((l->low >> 56) == ((l->low + l->range) >> 56)) {
+            ri_emit(l, out, &next, true);
+            l->range <<= 8;
+        }
+    }
+    for (size_t j = 0; j < n; j++) { // see rc_flush()
+        for (size_t k = 0; k < ri_code_bytes; k++) {
+            ri_emit(&lane[j], out, &next, false);
+        }
+    }
+    *written = next;
+    return 0;
+}
+
+struct ri_state { // decoder
+    uint64_t low;
+    uint64_t range;
+    uint64_t code;
+};
+
+static inline uint8_t ri_in(const uint8_t** p, const uint8_t* end,
+                            bool guarded, bool* truncated) {
+    if (!guarded || *p < end) { return *(*p)++; }
+    *truncated = true;
+    return 0;
+}
+
+static inline int32_t ri_decode_symbol(const struct static_model* sm,
+                                       struct ri_state* s,
+                                       const uint8_t** next,
+                                       const uint8_t* end, bool guarded) {
+    // returns symbol or -1 if input is corrupted or truncated
+    const uint8_t* p = *next;
+    bool truncated = false;
+    uint64_t low = s->low, range = s->range, code = s->code;
+    if (range < sm_total) {
+        code = (code << 8) + ri_in(&p, end, guarded, &truncated);
+        code = (code << 8) + ri_in(&p, end, guarded, &truncated);
+        low <<= 16;
+        range = UINT64_MAX - low;
+    }
+    range >>= sm_bits;
+    const uint64_t sum = (code - low) / range;
+    if (sum >= sm_total) { return -1; }
+    const uint8_t sym = sm->slot[sum];
+    low   += sm->start[sym] * range;
+    range *= sm->freq[sym];
+    while ((low >> 56) == ((low + range) >> 56)) {
+        code = (code << 8) + ri_in(&p, end, guarded, &truncated);
+        low   <<= 8;
+        range <<= 8;
+    }
+    s->low = low; s->range = range; s->code = code;
+    *next = p;
+    return truncated ? -1 : sym;
+}
+
+static inline const uint8_t* ri_decode_n(const struct static_model* sm,
+                                         const uint8_t* p, const uint8_t* end,
+                                         uint8_t out[], size_t count,
+                                         const size_t n) {
+    // `n` is a compile time constant at each call site. Lane states are
+    // kept in locals because stores to out[] may alias anything else.
+    // Returns null on corrupted input.
+    struct ri_state s[ri_max_lanes];
+    for (size_t j = 0; j < n; j++) {
+        s[j].low   = 0;
+        s[j].range = UINT64_MAX;
+        s[j].code  = 0;
+        for (size_t k = 0; k < ri_code_bytes; k++) {
+            s[j].code = (s[j].code << 8) + *p++;
+        }
+    }
+    size_t i = 0;
+    while (i + n <= count && (size_t)(end - p) >= n * ri_symbol_max) {
+        for (size_t j = 0; j < n; j++) {
+            const int32_t sym = ri_decode_symbol(sm, &s[j], &p, end, false);
+            if (sym < 0) { return null; }
+            out[i + j] = (uint8_t)sym;
+        }
+        i += n;
+    }
+    for (size_t j = 0; i < count; j = (j + 1) % n) { // input tail
+        const int32_t sym = ri_decode_symbol(sm, &s[j], &p, end, true);
+        if (sym < 0) { return null; }
+        out[i++] = (uint8_t)sym;
+    }
+    return p;
+}
+
+int32_t ri_decode(const struct static_model* sm, int32_t lanes,
+                  const uint8_t in[], size_t bytes,
+                  uint8_t out[], size_t count) {
+    if (!ri_valid_lanes(lanes)) { return rc_err_invalid; }
+    const size_t n = (size_t)lanes;
+    if (bytes < n * ri_code_bytes) { return rc_err_data; }
+    const uint8_t* p = null;
+    const uint8_t* end = in + bytes;
+    switch (n) {
+        case 1:  p = ri_decode_n(sm, in, end, out, count, 1); break;
+        case 2:  p = ri_decode_n(sm, in, end, out, count, 2); break;
+        case 4:  p = ri_decode_n(sm, in, end, out, count, 4); break;
+        default: p = ri_decode_n(sm, in, end, out, count, 8); break;
+    }
+    // every byte of the stream is consumed exactly once
+    return p == end ? 0 : rc_err_data;
+}
+
+#endif // rc_interleave_implementation
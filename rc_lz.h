@@ -0,0 +1,441 @@
+#ifndef rc_lz_header_included
+#define rc_lz_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// LZ77 front end for the range coder
+//
+// Input is parsed into literals and (length, distance) matches found
+// by a hash chain match finder: the hash of the next lz_min_length
+// bytes heads a chain of previous positions inside a window of
+// 1 << window_bits bytes. Levels 1..9 trade speed for ratio via the
+// depth of the chain search, the match length that stops the search
+// and lazy matching (a literal is emitted when the next position has
+// a longer match). Levels 8 and 9 parse optimally instead: blocks of
+// lz_opt_block positions are parsed by a shortest path search over
+// all literals and matches (every length of each longer match found
+// in the chain) priced with price tables (see pm_prices() in rc.h)
+// refreshed once per block. A match of `nice` length or longer ends
+// the block and is taken as is.
+//
+// Tokens are coded with separate prob_models per field (the way
+// rc_test6() codes text, sizes and distances):
+//   kind     literal or match in the context of the previous kind
+//   literal  byte
+//   length   length - lz_min_length (0..255)
+//   slot     bit length of distance - 1 in the context of the length
+//   extra    bits of distance - 1 below the leading 1, per byte
+//
+// Each lz_encode()/lz_decode() call codes an independent block: models
+// and the match finder are reset. The decoder must know `count` and
+// use the same window_bits. The decoder does not allocate memory.
+
+#include "rc.h"
+#include <stdbool.h>
+
+#define lz_min_length     4
+#define lz_max_length     (lz_min_length + 255)
+#define lz_default_level  6
+#define lz_default_window 20 // 1MB
+#define lz_hash_bits      17
+#define lz_opt_block      4096 // positions of optimal parse block
+
+struct lz_prices { // price tables of lz_model fields
+    struct price_table kind[2];
+    struct price_table literal;
+    struct price_table length;
+    struct price_table slot[3];
+    struct price_table extra[3];
+};
+
+struct lz_node; // of the optimal parse
+
+struct lz_model {
+    struct prob_model kind[2];  // literal (0) or match (1)
+    struct prob_model literal;
+    struct prob_model length;   // length - lz_min_length
+    struct prob_model slot[3];  // [min(length - lz_min_length, 2)]
+    struct prob_model extra[3]; // distance bits [byte]
+    uint32_t* head;  // 1 << lz_hash_bits positions + 1 (0 - empty)
+    uint32_t* chain; // 1 << window_bits previous positions + 1
+    struct lz_prices* prices;  // optimal parse only
+    struct lz_node*   node;    // lz_opt_block + 1 optimal parse nodes
+    uint32_t  window_bits;
+    uint32_t  depth;   // of the chain search
+    uint32_t  nice;    // match length that stops the search
+    bool      lazy;    // try a longer match at the next position
+    bool      optimal; // levels 8 and 9
+};
+
+// lz_init() returns rc_err_invalid for level outside [1..9] or
+// window_bits outside [10..24] (0 - defaults). Match finder tables
+// are allocated by the first lz_encode() (which returns
+// rc_err_no_memory on failure) and freed by lz_fini().
+// lz_encode() returns rc_err_too_big for count >= UINT32_MAX.
+// Both return 0 or rc->error (rc_err_data on corrupted input).
+
+int32_t lz_init(struct lz_model* lz, int32_t level, uint32_t window_bits);
+void    lz_fini(struct lz_model* lz);
+int32_t lz_encode(struct range_coder* rc, struct lz_model* lz,
+                  const uint8_t in[], size_t count);
+int32_t lz_decode(struct range_coder* rc, struct lz_model* lz,
+                  uint8_t out[], size_t count);
+
+#endif // rc_lz_header_included
+
+#ifdef rc_lz_implementation
+
+#include "unstd.h"
+
+struct lz_match {
+    uint32_t length; // 0 - no match
+    uint32_t distance;
+};
+
+struct lz_node {
+    uint32_t price;    // of the cheapest path to the node
+    uint32_t length;   // of the last step of the path (1 - literal)
+    uint32_t distance; // of the last step (0 - literal)
+};
+
+static const struct { uint32_t depth; uint32_t nice; bool lazy, optimal; }
+lz_levels[10] = {
+    {    0, 0,             false, false },
+    {    2, 8,             false, false }, // 1: fastest
+    {    4, 16,            false, false },
+    {    8, 32,            false, false },
+    {    8, 32,            true,  false },
+    {   16, 64,            true,  false },
+    {   32, 128,           true,  false }, // 6: default
+    {   64, lz_max_length, true,  false },
+    {   64, 128,           false, true  },
+    {  256, lz_max_length, false, true  }  // 9: best
+};
+
+int32_t lz_init(struct lz_model* lz, int32_t level, uint32_t window_bits) {
+    memset(lz, 0, sizeof(*lz));
+    if (level == 0) { level = lz_default_level; }
+    if (window_bits == 0) { window_bits = lz_default_window; }
+    if (level < 1 || level > 9 || window_bits < 10 || window_bits > 24) {
+        return rc_err_invalid;
+    }
+    lz->window_bits = window_bits;
+    lz->depth = lz_levels[level].depth;
+    lz->nice  = lz_levels[level].nice;
+    lz->lazy  = lz_levels[level].lazy;
+    lz->optimal = lz_levels[level].optimal;
+    return 0;
+}
+
+void lz_fini(struct lz_model* lz) {
+    free(lz->head);
+    free(lz->chain);
+    free(lz->prices);
+    free(lz->node);
+    lz->head   = null;
+    lz->chain  = null;
+    lz->prices = null;
+    lz->node   = null;
+}
+
+static void lz_reset(struct lz_model* lz) {
+    pm_init(&lz->kind[0], 2);
+    pm_init(&lz->kind[1], 2);
+    pm_init(&lz->literal, rc_sym_count);
+    pm_init(&lz->length, rc_sym_count);
+    for (size_t i = 0; i < countof(lz->slot); i++) {
+        pm_init(&lz->slot[i], lz->window_bits + 1);
+    }
+    for (size_t i = 0; i < countof(lz->extra); i++) {
+        pm_init(&lz->extra[i], rc_sym_count);
+    }
+}
+
+static inline uint32_t lz_hash(const uint8_t* p) {
+    const uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                       ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    return (v * 0x9E3779B1u) >> (32 - lz_hash_bits);
+}
+
+static inline uint32_t lz_insert(struct lz_model* lz, const uint8_t in[],
+                                 size_t count, size_t i) {
+    // inserts position i and returns previous head of its chain
+    if (count - i < lz_min_length) { return 0; }
+    const uint32_t h = lz_hash(in + i);
+    const uint32_t c = lz->head[h];
+    lz->head[h] = (uint32_t)i + 1;
+    lz->chain[i & ((1u << lz->window_bits) - 1)] = c;
+    return c;
+}
+
+static struct lz_match lz_find(struct lz_model* lz, const uint8_t in[],
+                               size_t count, size_t i,
+                               struct lz_match list[], uint32_t* found) {
+    // longest match for in[i..] at distance < 1 << window_bits,
+    // inserts position i into the chains. If list is not null it
+    // receives all matches of increasing length >= lz_min_length.
+    struct lz_match m = {0, 0};
+    const uint32_t mask = (1u << lz->window_bits) - 1;
+    uint32_t c = lz_insert(lz, in, count, i); // position + 1
+    const size_t limit = min(count - i, (size_t)lz_max_length);
+    uint32_t depth = lz->depth;
+    while (c != 0 && depth-- > 0) {
+        const size_t p = c - 1;
+        if (i - p > mask) { break; } // out of the window
+        if (in[p + m.length] == in[i + m.length]) {
+            uint32_t n = 0;
+            while (n < limit && in[p + n] == in[i + n]) { n++; }
+            if (n > m.length) {
+                m.length   = n;
+                m.distance = (uint32_t)(i - p);
+                if (list != null && n >= lz_min_length) {
+                    list[(*found)++] = m;
+                }
+                if (n >= lz->nice || n == limit) { break; }
+            }
+        }
+        const uint32_t next = lz->chain[p & mask];
+        if (next >= c) { break; } // stale entry
+        c = next;
+    }
+    if (m.length < lz_min_length) { m.length = 0; }
+    return m;
+}
+
+static void lz_put_literal(struct range_coder* rc, struct lz_model* lz,
+                           uint32_t* kind, uint8_t sym) {
+    rc_encode(rc, &lz->kind[*kind], 0);
+    rc_encode(rc, &lz->literal, sym);
+    *kind = 0;
+}
+
+static void lz_put_match(struct range_coder* rc, struct lz_model* lz,
+                         uint32_t* kind, const struct lz_match* m) {
+    rc_encode(rc, &lz->kind[*kind], 1);
+    const uint32_t v = m->length - lz_min_length;
+    rc_encode(rc, &lz->length, (uint8_t)v);
+    const uint32_t x = m->distance - 1;
+    uint32_t s = 0;
+    while ((x >> s) != 0) { s++; }
+    rc_encode(rc, &lz->slot[min(v, 2)], (uint8_t)s);
+    if (s > 1) {
+        const uint32_t e = s - 1; // bits below the leading 1
+        const uint32_t bits = x & ((1u << e) - 1);
+        for (int32_t j = (int32_t)(e - 1) / 8; j >= 0; j--) {
+            rc_encode(rc, &lz->extra[j], (uint8_t)(bits >> (j * 8)));
+        }
+    }
+    *kind = 1;
+}
+
+static void lz_greedy(struct range_coder* rc, struct lz_model* lz,
+                      const uint8_t in[], size_t count) {
+    uint32_t kind = 0;
+    size_t i = 0;
+    size_t inserted = 0; // positions [0..inserted) are in the chains
+    struct lz_match m = {0, 0};
+    if (count > 0) { m = lz_find(lz, in, count, 0, null, null); inserted = 1; }
+    while (i < count && rc->error == 0) {
+        if (m.length > 0 && lz->lazy && m.length < lz->nice &&
+            i + 1 < count) {
+            const struct lz_match n = lz_find(lz, in, count, i + 1,
+                                              null, null);
+            inserted = i + 2;
+            if (n.length > m.length) {
+                lz_put_literal(rc, lz, &kind, in[i]);
+                i++;
+                m = n;
+                continue;
+            }
+        }
+        if (m.length == 0) {
+            lz_put_literal(rc, lz, &kind, in[i]);
+            i++;
+        } else {
+            lz_put_match(rc, lz, &kind, &m);
+            i += m.length;
+        }
+        while (inserted < i) { lz_insert(lz, in, count, inserted++); }
+        if (i < count) {
+            m = lz_find(lz, in, count, i, null, null);
+            inserted = i + 1;
+        }
+    }
+}
+
+static void lz_refresh(struct lz_model* lz) {
+    struct lz_prices* p = lz->prices;
+    pm_prices(&lz->kind[0], &p->kind[0]);
+    pm_prices(&lz->kind[1], &p->kind[1]);
+    pm_prices(&lz->literal, &p->literal);
+    pm_prices(&lz->length, &p->length);
+    for (size_t i = 0; i < countof(p->slot); i++) {
+        pm_prices(&lz->slot[i], &p->slot[i]);
+    }
+    for (size_t i = 0; i < countof(p->extra); i++) {
+        pm_prices(&lz->extra[i], &p->extra[i]);
+    }
+}
+
+static void lz_distance_prices(const struct lz_prices* p, uint32_t distance,
+                               uint32_t price[3]) {
+    // price of the distance in each slot context (see lz_put_match())
+    const uint32_t x = distance - 1;
+    uint32_t s = 0;
+    while ((x >> s) != 0) { s++; }
+    uint32_t extra = 0;
+    if (s > 1) {
+        const uint32_t e = s - 1;
+        const uint32_t bits = x & ((1u << e) - 1);
+        for (int32_t j = (int32_t)(e - 1) / 8; j >= 0; j--) {
+            extra += p->extra[j].cost[(uint8_t)(bits >> (j * 8))];
+        }
+    }
+    for (uint32_t c = 0; c < 3; c++) { price[c] = p->slot[c].cost[s] + extra; }
+}
+
+static void lz_optimal(struct range_coder* rc, struct lz_model* lz,
+                       const uint8_t in[], size_t count) {
+    struct lz_node* node = lz->node;
+    const struct lz_prices* p = lz->prices;
+    struct lz_match list[lz_max_length];
+    uint32_t kind = 0;
+    size_t i = 0;
+    while (i < count && rc->error == 0) {
+        lz_refresh(lz);
+        const size_t end = min(count, i + lz_opt_block);
+        for (size_t r = 1; r <= end - i; r++) { node[r].price = UINT32_MAX; }
+        node[0] = (struct lz_node){ 0, 0, kind }; // kind of the last step
+        size_t stop = end;  // the parse of [i..stop)
+        struct lz_match tail = {0, 0}; // long match at stop
+        for (size_t k = i; k < end; k++) {
+            uint32_t found = 0;
+            const struct lz_match m = lz_find(lz, in, count, k, list, &found);
+            if (m.length >= lz->nice) { stop = k; tail = m; break; }
+            const struct lz_node* n = &node[k - i];
+            const uint32_t previous = n->distance != 0;
+            const uint32_t literal = n->price +
+                p->kind[previous].cost[0] + p->literal.cost[in[k]];
+            if (literal < node[k - i + 1].price) {
+                node[k - i + 1] = (struct lz_node){ literal, 1, 0 };
+            }
+            const uint32_t base = n->price + p->kind[previous].cost[1];
+            uint32_t length = lz_min_length;
+            for (uint32_t j = 0; j < found; j++) {
+                uint32_t dp[3];
+                lz_distance_prices(p, list[j].distance, dp);
+                const uint32_t last = (uint32_t)min((size_t)list[j].length,
+                                                    end - k);
+                for (; length <= last; length++) {
+                    const uint32_t v = length - lz_min_length;
+                    const uint32_t price = base + p->length.cost[v] +
+                                           dp[min(v, 2)];
+                    struct lz_node* t = &node[k - i + length];
+                    if (price < t->price) {
+                        *t = (struct lz_node){ price, length,
+                                               list[j].distance };
+                    }
+                }
+            }
+        }
+        // reverse the cheapest path to [i..stop) into forward steps
+        size_t r = stop - i;
+        uint32_t length = node[r].length;
+        uint32_t distance = node[r].distance;
+        while (r > 0) {
+            const size_t from = r - length;
+            const uint32_t l = node[from].length;
+            const uint32_t d = node[from].distance;
+            node[from].length   = length;
+            node[from].distance = distance;
+            length   = l;
+            distance = d;
+            r = from;
+        }
+        while (r < stop - i && rc->error == 0) {
+            const struct lz_node* n = &node[r];
+            if (n->distance == 0) {
+                lz_put_literal(rc, lz, &kind, in[i + r]);
+            } else {
+                const struct lz_match m = { n->length, n->distance };
+                lz_put_match(rc, lz, &kind, &m);
+            }
+            r += n->length;
+        }
+        i = stop;
+        if (tail.length > 0) {
+            lz_put_match(rc, lz, &kind, &tail);
+            for (size_t k = i + 1; k < i + tail.length; k++) {
+                lz_insert(lz, in, count, k);
+            }
+            i += tail.length;
+        }
+    }
+}
+
+int32_t lz_encode(struct range_coder* rc, struct lz_model* lz,
+                  const uint8_t in[], size_t count) {
+    if (count >= UINT32_MAX) { return rc_err_too_big; }
+    if (lz->head == null) {
+        lz->head  = (uint32_t*)malloc(sizeof(uint32_t) << lz_hash_bits);
+        lz->chain = (uint32_t*)malloc(sizeof(uint32_t) << lz->window_bits);
+        if (lz->optimal) {
+            lz->prices = (struct lz_prices*)malloc(sizeof(struct lz_prices));
+            lz->node = (struct lz_node*)malloc(sizeof(struct lz_node) *
+                                               (lz_opt_block + 1));
+        }
+        if (lz->head == null || lz->chain == null ||
+            (lz->optimal && (lz->prices == null || lz->node == null))) {
+            lz_fini(lz);
+            return rc_err_no_memory;
+        }
+    }
+    memset(lz->head, 0, sizeof(uint32_t) << lz_hash_bits);
+    lz_reset(lz);
+    if (lz->optimal) {
+        lz_optimal(rc, lz, in, count);
+    } else {
+        lz_greedy(rc, lz, in, count);
+    }
+    return rc->error;
+}
+
+int32_t lz_decode(struct range_coder* rc, struct lz_model* lz,
+                  uint8_t out[], size_t count) {
+    lz_reset(lz);
+    uint32_t kind = 0;
+    size_t i = 0;
+    while (i < count && rc->error == 0) {
+        kind = rc_decode(rc, &lz->kind[kind]) != 0;
+        if (kind == 0) {
+            out[i++] = rc_decode(rc, &lz->literal);
+        } else {
+            const uint32_t v = rc_decode(rc, &lz->length);
+            const uint32_t s = rc_decode(rc, &lz->slot[min(v, 2)]);
+            uint32_t x = s == 0 ? 0 : 1u << (s - 1);
+            if (s > 1 && s <= lz->window_bits) {
+                const uint32_t e = s - 1;
+                uint32_t bits = 0;
+                for (int32_t j = (int32_t)(e - 1) / 8; j >= 0; j--) {
+                    bits = (bits << 8) | rc_decode(rc, &lz->extra[j]);
+                }
+                x |= bits & (x - 1);
+            }
+            const size_t length = v + lz_min_length;
+            const size_t distance = (size_t)x + 1;
+            if (s > lz->window_bits || distance > i || length > count - i) {
+                if (rc->error == 0) { rc->error = rc_err_data; }
+            } else {
+                const uint8_t* from = out + i - distance;
+                for (size_t k = 0; k < length; k++) { out[i + k] = from[k]; }
+                i += length;
+            }
+        }
+    }
+    return rc->error;
+}
+
+#endif // rc_lz_implementation
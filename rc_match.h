@@ -0,0 +1,196 @@
+#ifndef rc_match_header_included
+#define rc_match_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// Match model: predicts the next byte from long repeats
+//
+// Past bytes are kept in a ring buffer of 1 << buffer_bits bytes.
+// The hash of the last ma_min_length bytes indexes a direct mapped
+// table of 1 << table_bits positions (one uint32_t per bucket, the most
+// recent occurrence wins). When no match is active the table candidate
+// is verified by comparing bytes backwards (hash collisions are
+// rejected) and the match length is its verified length. An active
+// match is followed byte by byte while predictions are correct thus
+// long repeats keep the longest (oldest) match.
+//
+// Binary interface (12 bit probabilities of 0 as rc_binary.h):
+// ma_p() predicts the next bit of the byte from the expected bit of
+// the predicted byte with adaptive confidence per match length,
+// ma_bit() learns the coded bit and ma_update() appends the whole byte.
+// ma_p() returns bc_prob_one / 2 when there is no prediction.
+
+#include "rc.h"
+#include "rc_binary.h"
+
+#define ma_min_length   6  // bytes hashed to find a match candidate
+#define ma_max_length   65535
+#define ma_buffer_bits  22 // default 4MB history
+#define ma_table_bits   18 // default 1MB of positions
+
+struct match_model {
+    uint8_t*  buffer;  // 1 << buffer_bits ring buffer of past bytes
+    uint32_t* table;   // 1 << table_bits positions (+1, 0 - empty)
+    uint32_t  buffer_bits;
+    uint32_t  table_bits;
+    uint32_t  pos;     // number of bytes seen (mod 2^32)
+    uint32_t  ptr;     // position of the predicted byte in buffer
+    uint32_t  length;  // of the active match, 0 - none
+    uint32_t  miss;    // bit of current byte mispredicted
+    uint16_t  p[64][2]; // 16 bit probability of 0 [length][expected]
+    uint32_t  index;   // of p[] used by ma_p()
+};
+
+// ma_init() returns rc_err_no_memory or rc_err_invalid for
+// buffer_bits outside [16..30] or table_bits outside [10..28]
+// (0 - defaults).
+
+int32_t ma_init(struct match_model* ma, uint32_t buffer_bits,
+                uint32_t table_bits);
+void    ma_reset(struct match_model* ma);
+void    ma_fini(struct match_model* ma);
+int32_t ma_predicted(const struct match_model* ma); // -1 or next byte
+uint32_t ma_p(struct match_model* ma, uint32_t node); // node 1..255
+void    ma_bit(struct match_model* ma, bool bit);
+void    ma_update(struct match_model* ma, uint8_t byte);
+
+#endif // rc_match_header_included
+
+#if defined(rc_match_implementation) && \
+   !defined(rc_match_implementation_included)
+#define rc_match_implementation_included // rc_mix.h includes rc_match.h
+
+#include "unstd.h"
+
+enum { ma_rate = 6 }; // adaptation of confidence probabilities
+
+int32_t ma_init(struct match_model* ma, uint32_t buffer_bits,
+                uint32_t table_bits) {
+    memset(ma, 0, sizeof(*ma));
+    if (buffer_bits == 0) { buffer_bits = ma_buffer_bits; }
+    if (table_bits  == 0) { table_bits  = ma_table_bits; }
+    if (buffer_bits < 16 || buffer_bits > 30 ||
+        table_bits < 10 || table_bits > 28) {
+        return rc_err_invalid;
+    }
+    ma->buffer_bits = buffer_bits;
+    ma->table_bits  = table_bits;
+    ma->buffer = (uint8_t*)malloc((size_t)1 << buffer_bits);
+    ma->table  = (uint32_t*)malloc(sizeof(uint32_t) << table_bits);
+    if (ma->buffer == null || ma->table == null) {
+        ma_fini(ma);
+        return rc_err_no_memory;
+    }
+    ma_reset(ma);
+    return 0;
+}
+
+void ma_reset(struct match_model* ma) {
+    memset(ma->table, 0, sizeof(uint32_t) << ma->table_bits);
+    ma->pos    = 0;
+    ma->ptr    = 0;
+    ma->length = 0;
+    ma->miss   = 0;
+    for (size_t i = 0; i < countof(ma->p); i++) {
+        ma->p[i][0] = 1u << 15;
+        ma->p[i][1] = 1u << 15;
+    }
+    ma->index = 0;
+}
+
+void ma_fini(struct match_model* ma) {
+    free(ma->buffer);
+    free(ma->table);
+    ma->buffer = null;
+    ma->table  = null;
+}
+
+static inline uint8_t ma_byte(const struct match_model* ma, uint32_t i) {
+    return ma->buffer[i & ((1u << ma->buffer_bits) - 1)];
+}
+
+int32_t ma_predicted(const struct match_model* ma) {
+    return ma->length > 0 ? ma_byte(ma, ma->ptr) : -1;
+}
+
+static uint32_t ma_bucket(const struct match_model* ma) {
+    // hash of the last ma_min_length bytes
+    uint32_t h = 0;
+    for (uint32_t i = 1; i <= ma_min_length; i++) {
+        h = (h + ma_byte(ma, ma->pos - i) + 1) * 0x2C1B3C6Du;
+    }
+    return (h ^ (h >> 15)) >> (32 - ma->table_bits);
+}
+
+static uint32_t ma_bucket_length(const struct match_model* ma) {
+    // log-like bucket of match length for confidence: 1..63
+    const uint32_t n = ma->length;
+    if (n < 16) { return n; }
+    if (n < 64) { return 16 + (n - 16) / 4; }         // 16..27
+    if (n < 512) { return 28 + (n - 64) / 16; }       // 28..55
+    return n < 1024 ? 56 + (n - 512) / 128 : 63;      // 56..63
+}
+
+uint32_t ma_p(struct match_model* ma, uint32_t node) {
+    ma->index = 0;
+    if (ma->length == 0 || ma->miss) { return bc_prob_one / 2; }
+    // node has leading 1 bit followed by the bits coded so far
+    int32_t bits = 0;
+    while ((node >> (bits + 1)) != 0) { bits++; }
+    const uint32_t expected = ma_byte(ma, ma->ptr) | 0x100;
+    if ((expected >> (8 - bits)) != node) { // diverged inside the byte
+        ma->miss = 1;
+        return bc_prob_one / 2;
+    }
+    const uint32_t bit = (expected >> (7 - bits)) & 1;
+    ma->index = (ma_bucket_length(ma) << 1) | bit;
+    const uint32_t p = ma->p[ma->index >> 1][bit] >> 4;
+    return p < 1 ? 1 : (p > bc_prob_one - 1 ? bc_prob_one - 1 : p);
+}
+
+void ma_bit(struct match_model* ma, bool bit) {
+    if (ma->index != 0) {
+        uint16_t* p = &ma->p[ma->index >> 1][ma->index & 1];
+        const int32_t target = bit ? 0 : 0xFFFF;
+        *p = (uint16_t)(*p + ((target - *p) >> ma_rate));
+        ma->index = 0;
+    }
+}
+
+void ma_update(struct match_model* ma, uint8_t byte) {
+    const uint32_t mask = (1u << ma->buffer_bits) - 1;
+    if (ma->length > 0 && ma_byte(ma, ma->ptr) == byte) {
+        ma->ptr++;
+        if (ma->length < ma_max_length) { ma->length++; }
+    } else {
+        ma->length = 0;
+    }
+    ma->miss = 0;
+    ma->buffer[ma->pos & mask] = byte;
+    ma->pos++;
+    if (ma->pos >= ma_min_length) {
+        const uint32_t b = ma_bucket(ma);
+        if (ma->length == 0 && ma->table[b] != 0) {
+            const uint32_t candidate = ma->table[b] - 1; // next byte at
+            // verify backwards within the buffer window
+            const uint32_t window = mask + 1 - ma_min_length;
+            uint32_t n = 0;
+            while (n < ma_max_length && n < candidate &&
+                   ma->pos - candidate + n < window &&
+                   ma_byte(ma, candidate - 1 - n) ==
+                   ma_byte(ma, ma->pos - 1 - n)) {
+                n++;
+            }
+            if (n >= ma_min_length) {
+                ma->length = n;
+                ma->ptr = candidate;
+            }
+        }
+        ma->table[b] = ma->pos + 1; // position of the next byte + 1
+    }
+}
+
+#endif // rc_match_implementation
@@ -0,0 +1,422 @@
+#ifndef rc_mix_header_included
+#define rc_mix_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// Logistic mixing of binary predictions (context mixing)
+//
+// Predictions are 12 bit probabilities of the bit being 0 (the same as
+// rc_binary.h). The mixer works in the logistic domain:
+//   stretch(p) = ln(p / (1 - p)) and squash(x) = 1 / (1 + e^-x)
+// both in fixed point (x scaled by 256 and clamped to +/-2047) and
+// computed from integer tables thus bit exact on all platforms.
+// Mixed prediction is squash(sum(w[i] * stretch(p[i]))) where weights
+// w[] (int16_t, 1.0 = 1 << 14) are selected by a small context and
+// trained online to minimize coding cost:
+//   w[i] += stretch(p[i]) * (target - p) * rate >> 16
+// Training uses SSE2 (pmulhw, paddsw) when available with identical
+// scalar fallback. The dot product is scalar (see mx_dot()).
+//
+// APM (adaptive probability map, also known as SSE - secondary symbol
+// estimation) refines a prediction in a context by interpolating
+// between 33 adaptive buckets of its stretched value.
+//
+// mix_model is a ready to use byte model: each byte is coded as 8
+// binary decisions (bit tree) with order-0, order-1, hashed order-2,
+// order-3, order-4 and match model (rc_match.h) bit predictions mixed
+// in the context of the partial byte and refined by APM in the order-1
+// context. Hashed contexts are rehashed for each nibble so the 15
+// counters of a nibble share a single 64 bytes cache line. rc_binary.h
+// and rc_match.h implementations must be present.
+// Each bit waits for the previous one (counters -> mixer -> APM ->
+// coder -> updates) thus speed is a few MB/s, several times slower
+// than a single bc_tree_encode() bit tree.
+
+#include "rc.h"
+#include "rc_binary.h"
+#include "rc_match.h"
+
+#define mx_max_inputs   16
+#define mx_max_contexts 256
+#define mx_one          (1 << 14) // weight of 1.0
+#define mx_default_rate 4
+#define mx_apm_contexts 256
+#define mx_apm_rate     7
+
+struct mixer {
+    int16_t  weight[mx_max_contexts][mx_max_inputs];
+    int16_t  input[mx_max_inputs]; // stretched predictions
+    uint32_t inputs;  // number of inputs
+    uint32_t lanes;   // inputs rounded up to 8 (zero weights and inputs)
+    uint32_t count;   // inputs added for the current bit
+    uint32_t context; // weight set selected by mx_mix()
+    int32_t  rate;    // learning rate 1..7
+    int32_t  p;       // last mixed prediction
+    int32_t  x;       // stretch(p) of the last mixed prediction
+};
+
+struct apm {
+    uint16_t t[mx_apm_contexts * 33]; // 16 bit probabilities
+    uint32_t index; // bucket for update
+};
+
+int32_t  mx_stretch(uint32_t p); // 12 bit probability -> [-2047..2047]
+uint32_t mx_squash(int32_t x);   // [-2047..2047] -> 12 bit probability
+
+// mx_init() sets all weights to 1.0 / inputs (inputs <= mx_max_inputs).
+// For each bit: mx_add() exactly `inputs` predictions, mx_mix() and
+// mx_update() with the coded bit.
+
+void     mx_init(struct mixer* mx, uint32_t inputs, int32_t rate);
+void     mx_add(struct mixer* mx, uint32_t p); // 12 bit probability of 0
+uint32_t mx_mix(struct mixer* mx, uint32_t context); // in (0..4096)
+void     mx_update(struct mixer* mx, bool bit);
+
+void     mx_apm_init(struct apm* a);
+uint32_t mx_apm(struct apm* a, uint32_t p, uint32_t context);
+void     mx_apm_update(struct apm* a, bool bit);
+
+struct mix_model { // counters: 22 bit probability of 0, 10 bit count
+    uint32_t     o0[rc_sym_count];                // node
+    uint32_t     o1[rc_sym_count * rc_sym_count]; // previous byte, node
+    uint32_t*    hashed;  // orders 2..4 previous bytes and nibble node
+    void*        memory;  // allocation of `hashed` (64 bytes aligned)
+    uint32_t     bits;    // log2 of number of hashed entries
+    uint32_t     history; // previous bytes, most recent in bits 0..7
+    struct mixer mx;
+    struct apm   apm;
+    struct match_model ma;
+};
+
+// mx_model_init() returns rc_err_no_memory or rc_err_invalid for
+// bits outside [16..24] (0 - default 22: 16MB for hashed orders).
+// Match model takes ma_buffer_bits and ma_table_bits defaults (5MB).
+
+int32_t mx_model_init(struct mix_model* mm, uint32_t bits);
+void    mx_model_reset(struct mix_model* mm);
+void    mx_model_fini(struct mix_model* mm);
+void    mx_encode(struct range_coder* rc, struct mix_model* mm, uint8_t sym);
+uint8_t mx_decode(struct range_coder* rc, struct mix_model* mm);
+
+#endif // rc_mix_header_included
+
+#ifdef rc_mix_implementation
+
+#include "unstd.h"
+#include <threads.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define mx_sse2
+#include <emmintrin.h>
+#endif
+
+static int16_t   mx_stretch_table[bc_prob_one];
+static uint16_t  mx_squash_table[2047 * 2 + 1]; // [-2047..2047]
+static once_flag mx_tables = ONCE_FLAG_INIT;    // both tables above
+
+uint32_t mx_squash(int32_t x) {
+    static const int32_t t[33] = { // 4096 / (1 + e^-(x / 256)) at x % 128
+        1, 2, 3, 6, 10, 16, 27, 45, 73, 120, 194, 310, 488, 747, 1101,
+        1546, 2047, 2549, 2994, 3348, 3607, 3785, 3901, 3975, 4022, 4050,
+        4068, 4079, 4085, 4089, 4092, 4093, 4094
+    };
+    if (x >  2047) { x =  2047; }
+    if (x < -2047) { x = -2047; }
+    const int32_t w = x & 127;
+    const int32_t i = (x >> 7) + 16;
+    return (uint32_t)((t[i] * (128 - w) + t[i + 1] * w + 64) >> 7);
+}
+
+static void mx_tables_init(void) { // stretch() is inverse of squash()
+    uint32_t pi = 0;
+    for (int32_t x = -2047; x <= 2047; x++) {
+        const uint32_t v = mx_squash(x);
+        mx_squash_table[x + 2047] = (uint16_t)v;
+        for (uint32_t i = pi; i <= v; i++) {
+            mx_stretch_table[i] = (int16_t)x;
+        }
+        pi = v + 1;
+    }
+    for (uint32_t i = pi; i < bc_prob_one; i++) {
+        mx_stretch_table[i] = 2047;
+    }
+}
+
+static void mx_init_tables(void) { // safe to call from any thread
+    call_once(&mx_tables, mx_tables_init);
+}
+
+int32_t mx_stretch(uint32_t p) {
+    assert(p < bc_prob_one);
+    return mx_stretch_table[p];
+}
+
+void mx_init(struct mixer* mx, uint32_t inputs, int32_t rate) {
+    assert(0 < inputs && inputs <= mx_max_inputs);
+    assert(0 < rate && rate <= 7); // (4095 * rate) fits into int16_t
+    mx_init_tables();
+    memset(mx, 0, sizeof(*mx));
+    for (size_t c = 0; c < mx_max_contexts; c++) {
+        for (size_t i = 0; i < inputs; i++) {
+            mx->weight[c][i] = (int16_t)(mx_one / inputs);
+        }
+    }
+    mx->inputs = inputs;
+    mx->lanes  = (inputs + 7) & ~7u;
+    mx->rate   = rate;
+    mx->p      = bc_prob_one / 2;
+}
+
+void mx_add(struct mixer* mx, uint32_t p) {
+    assert(mx->count < mx->inputs);
+    mx->input[mx->count++] = (int16_t)mx_stretch(p);
+}
+
+static int32_t mx_dot(const int16_t x[], const int16_t w[], uint32_t n) {
+    // sum of n products (|x| < 2^11, |w| < 2^15 fits int32_t), n % 8 == 0
+    // Scalar: x[] was just written by mx_add() one int16_t at a time and
+    // a 16 byte load of it cannot be forwarded from the pending stores.
+    int32_t s = 0;
+    for (size_t i = 0; i < n; i++) { s += x[i] * w[i]; }
+    return s;
+}
+
+static void mx_train(const int16_t x[], int16_t w[], int32_t e, uint32_t n) {
+    // w[i] += x[i] * e >> 16 with int16_t saturation, n % 8 == 0
+    #ifdef mx_sse2
+        const __m128i* a = (const __m128i*)x;
+        __m128i* b = (__m128i*)w;
+        const __m128i err = _mm_set1_epi16((int16_t)e);
+        for (size_t i = 0; i < n / 8; i++) {
+            const __m128i d = _mm_mulhi_epi16(_mm_loadu_si128(a + i), err);
+            _mm_storeu_si128(b + i, _mm_adds_epi16(_mm_loadu_si128(b + i), d));
+        }
+    #else
+        for (size_t i = 0; i < n; i++) {
+            const int32_t v = w[i] + ((x[i] * e) >> 16);
+            w[i] = (int16_t)(v < INT16_MIN ? INT16_MIN :
+                             (v > INT16_MAX ? INT16_MAX : v));
+        }
+    #endif
+}
+
+uint32_t mx_mix(struct mixer* mx, uint32_t context) {
+    assert(mx->count == mx->inputs && context < mx_max_contexts);
+    mx->context = context;
+    int32_t x = mx_dot(mx->input, mx->weight[context], mx->lanes) >> 14;
+    if (x >  2047) { x =  2047; }
+    if (x < -2047) { x = -2047; }
+    const uint32_t p = mx_squash_table[x + 2047]; // in [1..4094]
+    mx->x = x;
+    mx->p = (int32_t)p;
+    return p;
+}
+
+void mx_update(struct mixer* mx, bool bit) {
+    const int32_t err = ((int32_t)!bit << bc_prob_bits) - mx->p;
+    mx_train(mx->input, mx->weight[mx->context], err * mx->rate,
+             mx->lanes);
+    mx->count = 0;
+}
+
+void mx_apm_init(struct apm* a) {
+    mx_init_tables();
+    for (uint32_t c = 0; c < mx_apm_contexts; c++) {
+        for (int32_t j = 0; j < 33; j++) {
+            a->t[c * 33 + j] = (uint16_t)(mx_squash((j - 16) * 128) * 16);
+        }
+    }
+    a->index = 0;
+}
+
+static inline uint32_t mx_apm_stretched(struct apm* a, int32_t x,
+                                        uint32_t context) {
+    assert(context < mx_apm_contexts && -2047 <= x && x <= 2047);
+    const int32_t s = x + 2048; // [1..4095]
+    const int32_t w = s & 127;
+    a->index = (uint32_t)(s >> 7) + context * 33;
+    const uint32_t r = (a->t[a->index] * (128 - w) +
+                        a->t[a->index + 1] * w) >> 11;
+    return r < 1 ? 1 : (r > bc_prob_one - 1 ? bc_prob_one - 1 : r);
+}
+
+uint32_t mx_apm(struct apm* a, uint32_t p, uint32_t context) {
+    return mx_apm_stretched(a, mx_stretch(p), context);
+}
+
+void mx_apm_update(struct apm* a, bool bit) {
+    const int32_t y = !bit;
+    const int32_t g = (y << 16) + (y << mx_apm_rate) - y - y;
+    for (uint32_t i = a->index; i <= a->index + 1; i++) {
+        a->t[i] = (uint16_t)(a->t[i] + ((g - a->t[i]) >> mx_apm_rate));
+    }
+}
+
+enum {
+    mx_hashed_orders = 3, // 2, 3 and 4
+    mx_model_inputs  = 4 + mx_hashed_orders, // + order-0, order-1,
+                                             //   match and bias
+    mx_count_limit  = 255 // counters adapt at rate 1 / (count + 1.5)
+};
+
+static const uint32_t mx_counter_init = (1u << 31) | 0; // p = 1/2, n = 0
+
+int32_t mx_model_init(struct mix_model* mm, uint32_t bits) {
+    memset(mm, 0, sizeof(*mm));
+    if (bits == 0) { bits = 22; }
+    if (bits < 16 || bits > 24) { return rc_err_invalid; }
+    mm->bits = bits;
+    mm->memory = malloc((sizeof(uint32_t) << bits) + 64);
+    if (mm->memory == null) { return rc_err_no_memory; }
+    mm->hashed = (uint32_t*)(((uintptr_t)mm->memory + 63) & ~(uintptr_t)63);
+    const int32_t r = ma_init(&mm->ma, 0, 0);
+    if (r != 0) { mx_model_fini(mm); return r; }
+    mx_model_reset(mm);
+    return 0;
+}
+
+void mx_model_reset(struct mix_model* mm) {
+    for (size_t i = 0; i < countof(mm->o0); i++) {
+        mm->o0[i] = mx_counter_init;
+    }
+    for (size_t i = 0; i < countof(mm->o1); i++) {
+        mm->o1[i] = mx_counter_init;
+    }
+    for (size_t i = 0; i < (1u << mm->bits); i++) {
+        mm->hashed[i] = mx_counter_init;
+    }
+    mm->history = 0;
+    mx_init(&mm->mx, mx_model_inputs, mx_default_rate);
+    mx_apm_init(&mm->apm);
+    ma_reset(&mm->ma);
+}
+
+void mx_model_fini(struct mix_model* mm) {
+    free(mm->memory);
+    mm->memory = null;
+    mm->hashed = null;
+    ma_fini(&mm->ma);
+}
+
+static inline uint32_t mx_p12(uint32_t counter) { // 12 bit (0..4096)
+    const uint32_t p = counter >> 20;
+    return p < 1 ? 1 : (p > bc_prob_one - 1 ? bc_prob_one - 1 : p);
+}
+
+static const uint16_t mx_reciprocal[mx_count_limit + 1] = { // 2^16 / (n + 1.5)
+    43690, 26214, 18724, 14563, 11915, 10082,  8738,  7710,  6898,  6241,
+     5698,  5242,  4854,  4519,  4228,  3971,  3744,  3542,  3360,  3196,
+     3048,  2912,  2788,  2674,  2570,  2473,  2383,  2299,  2221,  2148,
+     2080,  2016,  1956,  1899,  1846,  1795,  1747,  1702,  1659,  1618,
+     1579,  1542,  1506,  1472,  1440,  1409,  1379,  1351,  1323,  1297,
+     1272,  1248,  1224,  1202,  1180,  1159,  1139,  1120,  1101,  1083,
+     1065,  1048,  1032,  1016,  1000,   985,   970,   956,   942,   929,
+      916,   903,   891,   879,   868,   856,   845,   834,   824,   814,
+      804,   794,   784,   775,   766,   757,   748,   740,   732,   724,
+      716,   708,   700,   693,   686,   679,   672,   665,   658,   652,
+      645,   639,   633,   627,   621,   615,   609,   604,   598,   593,
+      587,   582,   577,   572,   567,   562,   557,   553,   548,   543,
+      539,   534,   530,   526,   522,   518,   514,   510,   506,   502,
+      498,   494,   490,   487,   483,   480,   476,   473,   469,   466,
+      463,   459,   456,   453,   450,   447,   444,   441,   438,   435,
+      432,   429,   426,   424,   421,   418,   416,   413,   410,   408,
+      405,   403,   400,   398,   395,   393,   391,   388,   386,   384,
+      382,   379,   377,   375,   373,   371,   369,   367,   365,   363,
+      361,   359,   357,   355,   353,   351,   349,   347,   345,   344,
+      342,   340,   338,   336,   335,   333,   331,   330,   328,   326,
+      325,   323,   322,   320,   318,   317,   315,   314,   312,   311,
+      309,   308,   306,   305,   304,   302,   301,   299,   298,   297,
+      295,   294,   293,   291,   290,   289,   288,   286,   285,   284,
+      283,   281,   280,   279,   278,   277,   275,   274,   273,   272,
+      271,   270,   269,   268,   266,   265,   264,   263,   262,   261,
+      260,   259,   258,   257,   256,   255
+};
+
+static inline void mx_count(uint32_t* counter, bool bit) {
+    // p += (target - p) / (n + 1.5) for n < mx_count_limit
+    const uint32_t n = *counter & 1023;
+    const int64_t p = *counter >> 10;
+    const int64_t target = bit ? 0 : (1 << 22) - 1;
+    const int64_t q = p + (((target - p) * mx_reciprocal[n]) >> 16);
+    *counter = ((uint32_t)q << 10) | (n < mx_count_limit ? n + 1 : n);
+}
+
+static void mx_hash(const struct mix_model* mm, uint32_t nibble,
+                    uint32_t slot[]) {
+    // 16 entries slots of hashed orders for the next nibble:
+    // nibble is 1 for the high nibble or 16 + value of the high nibble
+    for (uint32_t k = 0; k < mx_hashed_orders; k++) {
+        const uint32_t order = k + 2;
+        const uint32_t mask = order < 4 ? (1u << (order * 8)) - 1 : ~0u;
+        uint32_t h = ((mm->history & mask) + order * 0x01000193u) *
+                     0x9E3779B1u;
+        h = (h ^ (h >> 15) ^ nibble) * 0x2C1B3C6Du;
+        slot[k] = (h >> (32 - mm->bits + 4)) << 4;
+    }
+}
+
+static bool mx_code(struct range_coder* rc, struct mix_model* mm,
+                    uint32_t node, uint32_t j, const uint32_t slot[],
+                    bool bit, bool encode) {
+    // node is the partial byte with leading 1 bit (1..255) and
+    // j is the partial nibble with leading 1 bit (1..15)
+    uint32_t* c[2 + mx_hashed_orders] = {
+        &mm->o0[node],
+        &mm->o1[(mm->history & 0xFF) * rc_sym_count + node]
+    };
+    for (uint32_t k = 0; k < mx_hashed_orders; k++) {
+        c[2 + k] = &mm->hashed[slot[k] | j];
+    }
+    for (uint32_t k = 0; k < countof(c); k++) {
+        mx_add(&mm->mx, mx_p12(*c[k]));
+    }
+    mx_add(&mm->mx, ma_p(&mm->ma, node));
+    mx_add(&mm->mx, bc_prob_one / 2 + 256); // bias input
+    const uint32_t pm = mx_mix(&mm->mx, node);
+    // APM of the mixer output before squash() saves a stretch() lookup
+    const uint32_t pa = mx_apm_stretched(&mm->apm, mm->mx.x,
+                                         mm->history & 0xFF);
+    const uint32_t p  = (pm + pa * 3 + 2) / 4;
+    if (encode) {
+        bc_encode_bit(rc, p, bit);
+    } else {
+        bit = bc_decode_bit(rc, p);
+    }
+    mx_update(&mm->mx, bit);
+    mx_apm_update(&mm->apm, bit);
+    ma_bit(&mm->ma, bit);
+    for (uint32_t k = 0; k < countof(c); k++) { mx_count(c[k], bit); }
+    return bit;
+}
+
+static uint8_t mx_byte(struct range_coder* rc, struct mix_model* mm,
+                       uint8_t sym, bool encode) {
+    uint32_t slot[mx_hashed_orders];
+    uint32_t node = 1;
+    uint32_t j = 1;
+    for (int32_t i = rc_sym_bits - 1; i >= 0; i--) {
+        if (j == 1) { mx_hash(mm, node, slot); } // nibble boundary
+        const bool bit = mx_code(rc, mm, node, j, slot, (sym >> i) & 1,
+                                 encode);
+        node = (node << 1) | bit;
+        j = node < 16 || node >= 32 ? (j << 1) | bit : 1;
+    }
+    sym = (uint8_t)(node - rc_sym_count);
+    mm->history = (mm->history << 8) | sym;
+    ma_update(&mm->ma, sym);
+    return sym;
+}
+
+void mx_encode(struct range_coder* rc, struct mix_model* mm, uint8_t sym) {
+    mx_byte(rc, mm, sym, true);
+}
+
+uint8_t mx_decode(struct range_coder* rc, struct mix_model* mm) {
+    return mx_byte(rc, mm, 0, false);
+}
+
+#endif // rc_mix_implementation
@@ -0,0 +1,368 @@
+#ifndef rc_ppm_header_included
+#define rc_ppm_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// PPM (prediction by partial matching) model
+//
+// Contexts of order 0..order are kept in a trie keyed by the previous
+// bytes, most recent first, thus the parent of a context is its
+// suffix (one order lower). Each context node has a variable size list
+// of entries: frequency of the byte as the next symbol and the child
+// context extended with that byte. Only seen symbols have non zero
+// frequencies, unseen symbols are coded via the escape symbol that
+// falls back to the lower order (method D: escape frequency is the
+// number of distinct symbols, seen symbols are incremented by 2).
+// Symbols of the higher order contexts are excluded in the lower
+// ones. Order -1 codes remaining symbols of the alphabet uniformly.
+// A context is extended by one order each time it is used.
+//
+// All nodes and lists come from a single arena of fixed `memory`
+// size allocated by pp_init(). When the arena is exhausted the model
+// restarts from scratch (encoder and decoder do it at the same
+// symbol). No allocations happen in pp_encode()/pp_decode().
+
+#include "rc.h"
+
+#define pp_max_order 8
+#define pp_limit     (1u << 15) // node total that triggers halving rescale
+
+struct ppm_model {
+    uint8_t* arena;
+    size_t   memory;   // arena bytes
+    size_t   used;     // arena bytes in use
+    uint32_t order;    // maximum context order 1..pp_max_order
+    uint32_t symbols;  // alphabet size for order -1 coding
+    uint32_t root;     // order-0 context node offset in arena
+    uint32_t length;   // number of valid bytes in history[] <= order
+    uint8_t  history[pp_max_order]; // previous bytes, most recent first
+    uint32_t restarts; // number of times the arena was exhausted
+};
+
+// pp_init() allocates the arena (memory is in [64KB..4GB)) and returns
+// rc_err_no_memory on failure, rc_err_invalid for wrong arguments.
+// symbols as in pm_init(): n <= 256 first symbols of the alphabet.
+// pp_reset() restores the initial state (e.g. for the next block).
+// pp_encode() of sym >= symbols sets rc->error to rc_err_invalid.
+
+int32_t pp_init(struct ppm_model* pp, uint32_t order, uint32_t symbols,
+                size_t memory);
+void    pp_reset(struct ppm_model* pp);
+void    pp_fini(struct ppm_model* pp);
+void    pp_encode(struct range_coder* rc, struct ppm_model* pp, uint8_t sym);
+uint8_t pp_decode(struct range_coder* rc, struct ppm_model* pp);
+
+#endif // rc_ppm_header_included
+
+#ifdef rc_ppm_implementation
+
+#include "unstd.h"
+
+struct pp_node { // context
+    uint32_t entries;  // offset of struct pp_entry[capacity]
+    uint16_t count;    // number of entries
+    uint16_t capacity;
+    uint32_t total;    // sum of entries frequencies
+    uint16_t distinct; // number of entries with non zero frequency
+    uint16_t reserved;
+};
+
+struct pp_entry {
+    uint8_t  sym;
+    uint8_t  reserved;
+    uint16_t freq;  // as the next symbol in the context, 0 - unseen
+    uint32_t child; // offset of context extended by `sym` or 0
+};
+
+struct pp_exclusion { // symbols already coded in higher orders
+    uint64_t bits[rc_sym_count / 64];
+    uint32_t count;
+};
+
+enum { pp_inc = 2 }; // frequency increment of seen symbols (method D)
+
+static inline struct pp_node* pp_node(struct ppm_model* pp, uint32_t offset) {
+    return (struct pp_node*)(pp->arena + offset);
+}
+
+static inline struct pp_entry* pp_entries(struct ppm_model* pp,
+                                          const struct pp_node* n) {
+    return (struct pp_entry*)(pp->arena + n->entries);
+}
+
+static uint32_t pp_alloc(struct ppm_model* pp, size_t bytes) {
+    // returns 0 when the arena is exhausted (offset 0 is never used)
+    bytes = (bytes + 7) & ~(size_t)7;
+    if (pp->memory - pp->used < bytes) { return 0; }
+    const uint32_t offset = (uint32_t)pp->used;
+    pp->used += bytes;
+    return offset;
+}
+
+static uint32_t pp_new_node(struct ppm_model* pp) {
+    const uint32_t offset = pp_alloc(pp, sizeof(struct pp_node));
+    if (offset != 0) { memset(pp->arena + offset, 0, sizeof(struct pp_node)); }
+    return offset;
+}
+
+static inline bool pp_excluded(const struct pp_exclusion* x, uint8_t sym) {
+    return (x->bits[sym / 64] >> (sym % 64)) & 1;
+}
+
+static void pp_exclude(struct ppm_model* pp, struct pp_exclusion* x,
+                       const struct pp_node* n) {
+    const struct pp_entry* e = pp_entries(pp, n);
+    for (uint32_t i = 0; i < n->count; i++) {
+        if (e[i].freq > 0 && !pp_excluded(x, e[i].sym)) {
+            x->bits[e[i].sym / 64] |= 1uLL << (e[i].sym % 64);
+            x->count++;
+        }
+    }
+}
+
+static struct pp_entry* pp_find(struct ppm_model* pp,
+                                const struct pp_node* n, uint8_t sym) {
+    struct pp_entry* e = pp_entries(pp, n);
+    for (uint32_t i = 0; i < n->count; i++) {
+        if (e[i].sym == sym) { return &e[i]; }
+    }
+    return null;
+}
+
+static struct pp_entry* pp_add(struct ppm_model* pp, uint32_t node,
+                               uint8_t sym) {
+    // returns null when the arena is exhausted
+    struct pp_node* n = pp_node(pp, node);
+    if (n->count == n->capacity) { // grow list, old one is abandoned
+        const uint32_t capacity = n->capacity == 0 ? 2 : n->capacity * 2;
+        const uint32_t entries = pp_alloc(pp,
+            capacity * sizeof(struct pp_entry));
+        if (entries == 0) { return null; }
+        memcpy(pp->arena + entries, pp->arena + n->entries,
+               n->count * sizeof(struct pp_entry));
+        n->entries  = entries;
+        n->capacity = (uint16_t)capacity;
+    }
+    struct pp_entry* e = pp_entries(pp, n) + n->count++;
+    e->sym = sym;
+    e->reserved = 0;
+    e->freq = 0;
+    e->child = 0;
+    return e;
+}
+
+static void pp_rescale(struct pp_node* n, struct pp_entry e[]) {
+    n->total = 0;
+    for (uint32_t i = 0; i < n->count; i++) {
+        e[i].freq = (uint16_t)((e[i].freq + 1) / 2); // keeps non zero
+        n->total += e[i].freq;
+    }
+}
+
+static void pp_increment(struct ppm_model* pp, struct pp_node* n,
+                         struct pp_entry* e) {
+    if (e->freq == 0) { // new symbol in this context
+        e->freq = 1;
+        n->total++;
+        n->distinct++;
+    } else {
+        e->freq += pp_inc;
+        n->total += pp_inc;
+    }
+    if (n->total > pp_limit) { pp_rescale(n, pp_entries(pp, n)); }
+}
+
+void pp_reset(struct ppm_model* pp) {
+    pp->used = 8; // offset 0 is "null"
+    pp->root = pp_new_node(pp);
+    pp->length = 0;
+    memset(pp->history, 0, sizeof(pp->history));
+}
+
+int32_t pp_init(struct ppm_model* pp, uint32_t order, uint32_t symbols,
+                size_t memory) {
+    memset(pp, 0, sizeof(*pp));
+    if (order < 1 || order > pp_max_order || symbols < 2 ||
+        symbols > rc_sym_count || memory < 64 * 1024 ||
+        memory > UINT32_MAX) {
+        return rc_err_invalid;
+    }
+    pp->arena = (uint8_t*)malloc(memory);
+    if (pp->arena == null) { return rc_err_no_memory; }
+    pp->memory  = memory;
+    pp->order   = order;
+    pp->symbols = symbols;
+    pp_reset(pp);
+    return 0;
+}
+
+void pp_fini(struct ppm_model* pp) {
+    free(pp->arena);
+    pp->arena = null;
+}
+
+static uint32_t pp_contexts(struct ppm_model* pp, uint32_t ctx[]) {
+    // ctx[k] is the context of order k for k in [0..depth], returns depth
+    ctx[0] = pp->root;
+    uint32_t depth = 0;
+    while (depth < pp->length) {
+        const struct pp_entry* e = pp_find(pp, pp_node(pp, ctx[depth]),
+                                           pp->history[depth]);
+        if (e == null || e->child == 0) { break; }
+        ctx[++depth] = e->child;
+    }
+    return depth;
+}
+
+static void pp_update(struct ppm_model* pp, const uint32_t ctx[],
+                      uint32_t depth, int32_t found, uint8_t sym) {
+    // contexts above the one that coded `sym` learn it (update exclusion)
+    bool full = false;
+    const uint32_t lowest = found < 0 ? 0 : (uint32_t)found;
+    for (uint32_t k = lowest; k <= depth && !full; k++) {
+        struct pp_entry* e = pp_find(pp, pp_node(pp, ctx[k]), sym);
+        if (e == null) { e = pp_add(pp, ctx[k], sym); }
+        if (e == null) {
+            full = true;
+        } else {
+            pp_increment(pp, pp_node(pp, ctx[k]), e);
+        }
+    }
+    if (!full && depth < pp->order && depth < pp->length) {
+        // extend the deepest context by one more byte of history
+        const uint8_t b = pp->history[depth];
+        struct pp_entry* e = pp_find(pp, pp_node(pp, ctx[depth]), b);
+        if (e == null) { e = pp_add(pp, ctx[depth], b); }
+        const uint32_t child = e == null ? 0 : pp_new_node(pp);
+        if (child == 0) {
+            full = true;
+        } else {
+            pp_find(pp, pp_node(pp, ctx[depth]), b)->child = child;
+            e = pp_add(pp, child, sym);
+            if (e == null) {
+                full = true;
+            } else {
+                pp_increment(pp, pp_node(pp, child), e);
+            }
+        }
+    }
+    memmove(pp->history + 1, pp->history, pp_max_order - 1);
+    pp->history[0] = sym;
+    if (pp->length < pp->order) { pp->length++; }
+    if (full) { // restart keeping history
+        uint8_t history[pp_max_order];
+        const uint32_t length = pp->length;
+        memcpy(history, pp->history, sizeof(history));
+        pp_reset(pp);
+        memcpy(pp->history, history, sizeof(history));
+        pp->length = length;
+        pp->restarts++;
+    }
+}
+
+void pp_encode(struct range_coder* rc, struct ppm_model* pp, uint8_t sym) {
+    if (sym >= pp->symbols) { // would not be decodable
+        if (rc->error == 0) { rc->error = rc_err_invalid; }
+        return;
+    }
+    uint32_t ctx[pp_max_order + 1];
+    const uint32_t depth = pp_contexts(pp, ctx);
+    struct pp_exclusion x = {0};
+    int32_t found = -1;
+    for (int32_t k = (int32_t)depth; k >= 0 && found < 0; k--) {
+        const struct pp_node* n = pp_node(pp, ctx[k]);
+        const struct pp_entry* e = pp_entries(pp, n);
+        uint32_t total = 0, start = 0, freq = 0, distinct = 0;
+        for (uint32_t i = 0; i < n->count; i++) {
+            if (e[i].freq > 0 && !pp_excluded(&x, e[i].sym)) {
+                if (e[i].sym == sym) { start = total; freq = e[i].freq; }
+                total += e[i].freq;
+                distinct++;
+            }
+        }
+        if (distinct == 0) { continue; } // nothing to code here
+        if (freq > 0) {
+            rc_encode_range(rc, start, freq, total + distinct);
+            found = k;
+        } else {
+            rc_encode_range(rc, total, distinct, total + distinct);
+            pp_exclude(pp, &x, n);
+        }
+    }
+    if (found < 0) { // order -1
+        uint32_t start = 0;
+        for (uint32_t s = 0; s < sym; s++) {
+            if (!pp_excluded(&x, (uint8_t)s)) { start++; }
+        }
+        rc_encode_range(rc, start, 1, pp->symbols - x.count);
+    }
+    pp_update(pp, ctx, depth, found, sym);
+}
+
+static uint8_t pp_error(struct range_coder* rc) {
+    if (rc->error == 0) { rc->error = rc_err_data; }
+    return 0;
+}
+
+uint8_t pp_decode(struct range_coder* rc, struct ppm_model* pp) {
+    uint32_t ctx[pp_max_order + 1];
+    const uint32_t depth = pp_contexts(pp, ctx);
+    struct pp_exclusion x = {0};
+    int32_t found = -1;
+    uint8_t sym = 0;
+    for (int32_t k = (int32_t)depth; k >= 0 && found < 0; k--) {
+        const struct pp_node* n = pp_node(pp, ctx[k]);
+        const struct pp_entry* e = pp_entries(pp, n);
+        uint32_t total = 0, distinct = 0;
+        for (uint32_t i = 0; i < n->count; i++) {
+            if (e[i].freq > 0 && !pp_excluded(&x, e[i].sym)) {
+                total += e[i].freq;
+                distinct++;
+            }
+        }
+        if (distinct == 0) { continue; }
+        const uint64_t sum = rc_decode_freq(rc, total + distinct);
+        if (sum >= total + distinct) { return pp_error(rc); }
+        if (sum >= total) {
+            rc_decode_range(rc, total, distinct);
+            pp_exclude(pp, &x, n);
+        } else {
+            uint32_t start = 0;
+            uint32_t i = 0;
+            for (;;) {
+                if (e[i].freq > 0 && !pp_excluded(&x, e[i].sym)) {
+                    if (sum < start + e[i].freq) { break; }
+                    start += e[i].freq;
+                }
+                i++;
+            }
+            rc_decode_range(rc, start, e[i].freq);
+            sym = e[i].sym;
+            found = k;
+        }
+    }
+    if (found < 0) { // order -1
+        const uint32_t remaining = pp->symbols - x.count;
+        if (remaining == 0) { return pp_error(rc); }
+        const uint64_t sum = rc_decode_freq(rc, remaining);
+        if (sum >= remaining) { return pp_error(rc); }
+        uint32_t s = 0;
+        uint32_t k = 0;
+        for (;;) {
+            if (!pp_excluded(&x, (uint8_t)s)) {
+                if (k == sum) { break; }
+                k++;
+            }
+            s++;
+        }
+        rc_decode_range(rc, sum, 1);
+        sym = (uint8_t)s;
+    }
+    pp_update(pp, ctx, depth, found, sym);
+    return sym;
+}
+
+#endif // rc_ppm_implementation
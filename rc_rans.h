@@ -0,0 +1,204 @@
+#ifndef rc_rans_header_included
+#define rc_rans_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// rANS (range asymmetric numeral systems) backend
+//
+// Uses static_model statistics of rc.h (normalized to sm_total) thus
+// frequencies are static per block (block adaptive when the table is
+// rebuilt for each block, see rb_method_rans in rc_block.h).
+// 2, 4 or 8 interleaved 32 bit states take symbols round robin
+// (symbol i is coded by state i % states) so the decoder can overlap
+// their dependency chains. Encoder runs backwards writing bytes from
+// the end of the output buffer and moves the result to the front.
+//
+// Stream layout: uint32_t state[states] (little endian, state 0 first)
+// followed by renormalization bytes in decoding order.
+// Decoder verifies that all states return to the initial value and
+// the whole input has been consumed.
+
+#include "rc.h"
+
+#define ra_max_states 8
+#define ra_table_max  (rc_sym_count / 8 + rc_sym_count * 2)
+
+// ra_put_table() stores normalized frequencies of the model in out[]
+// (at most ra_table_max bytes) and returns number of bytes written.
+// ra_get_table() restores the model and returns number of bytes
+// consumed or 0 if table is corrupted.
+
+size_t  ra_put_table(const struct static_model* sm, uint8_t out[]);
+size_t  ra_get_table(struct static_model* sm, const uint8_t in[],
+                     size_t bytes);
+int32_t ra_encode(const struct static_model* sm, int32_t states,
+                  const uint8_t in[], size_t count,
+                  uint8_t out[], size_t capacity, size_t* written);
+int32_t ra_decode(const struct static_model* sm, int32_t states,
+                  const uint8_t in[], size_t bytes,
+                  uint8_t out[], size_t count);
+
+#endif // rc_rans_header_included
+
+#ifdef rc_rans_implementation
+
+#include "unstd.h"
+
+enum {
+    ra_lower = 1u << 23, // states are kept in [ra_lower..ra_lower << 8)
+    ra_mask  = sm_total - 1
+};
+
+static bool ra_valid_states(int32_t states) {
+    return states == 1 || states == 2 || states == 4 || states == 8;
+}
+
+size_t ra_put_table(const struct static_model* sm, uint8_t out[]) {
+    // bitmap of present symbols then freq - 1 as 1 or 2 bytes varint
+    uint8_t* p = out + rc_sym_count / 8;
+    memset(out, 0, rc_sym_count / 8);
+    for (size_t i = 0; i < rc_sym_count; i++) {
+        const uint32_t f = sm->freq[i];
+        if (f > 0) {
+            out[i / 8] |= (uint8_t)(1u << (i % 8));
+            const uint32_t v = f - 1;
+            if (v < 0x80) {
+                *p++ = (uint8_t)v;
+            } else {
+                *p++ = (uint8_t)(0x80 | (v & 0x7F));
+                *p++ = (uint8_t)(v >> 7);
+            }
+        }
+    }
+    return (size_t)(p - out);
+}
+
+size_t ra_get_table(struct static_model* sm, const uint8_t in[],
+                    size_t bytes) {
+    if (bytes < rc_sym_count / 8) { return 0; }
+    const uint8_t* p = in + rc_sym_count / 8;
+    const uint8_t* e = in + bytes;
+    uint64_t freq[rc_sym_count];
+    uint32_t total = 0;
+    for (size_t i = 0; i < rc_sym_count; i++) {
+        freq[i] = 0;
+        if (in[i / 8] & (1u << (i % 8))) {
+            if (p >= e) { return 0; }
+            uint32_t v = *p++;
+            if (v & 0x80) {
+                if (p >= e) { return 0; }
+                v = (v & 0x7F) | ((uint32_t)*p++ << 7);
+            }
+            freq[i] = v + 1;
+            total += v + 1;
+        }
+    }
+    // normalized frequencies are reproduced exactly by sm_init()
+    if (total != sm_total || sm_init(sm, freq) != 0) { return 0; }
+    return (size_t)(p - in);
+}
+
+int32_t ra_encode(const struct static_model* sm, int32_t states,
+                  const uint8_t in[], size_t count,
+                  uint8_t out[], size_t capacity, size_t* written) {
+    *written = 0;
+    if (!ra_valid_states(states)) { return rc_err_invalid; }
+    const size_t n = (size_t)states;
+    uint32_t x[ra_max_states];
+    for (size_t j = 0; j < n; j++) { x[j] = ra_lower; }
+    uint8_t* p = out + capacity; // written backwards
+    size_t i = count;
+    while (i > 0) {
+        i--;
+        const uint8_t  s = in[i];
+        const uint32_t f = sm->freq[s];
+        if (f == 0) { return rc_err_invalid; } // not in the model
+        const uint32_t x_max = ((ra_lower >> sm_bits) << 8) * f;
+        uint32_t v = x[i & (n - 1)];
+        while (v >= x_max) {
+            if (p == out) { return rc_err_no_space; }
+            *--p = (uint8_t)v;
+            v >>= 8;
+        }
+        x[i & (n - 1)] = ((v / f) << sm_bits) + (v % f) + sm->start[s];
+    }
+    if ((size_t)(p - out) < n * 4) { return rc_err_no_space; }
+    for (size_t j = n; j > 0; j--) {
+        p -= 4;
+        const uint32_t v = x[j - 1];
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+        p[3] = (uint8_t)(v >> 24);
+    }
+    *written = (size_t)(out + capacity - p);
+    memmove(out, p, *written);
+    return 0;
+}
+
+static inline uint8_t ra_decode_symbol(const struct static_model* sm,
+                                       uint32_t* x) {
+    const uint32_t v = *x;
+    const uint8_t s = sm->slot[v & ra_mask];
+    *x = sm->freq[s] * (v >> sm_bits) + (v & ra_mask) - sm->start[s];
+    return s;
+}
+
+static inline const uint8_t* ra_decode_n(const struct static_model* sm,
+                                         uint32_t state[],
+                                         const uint8_t* p, const uint8_t* end,
+                                         uint8_t out[], size_t count,
+                                         const size_t n) {
+    // `n` is a compile time constant at each call site. State is kept
+    // in locals because stores to out[] may alias anything else.
+    uint32_t x[ra_max_states];
+    for (size_t j = 0; j < n; j++) { x[j] = state[j]; }
+    size_t i = 0;
+    // a symbol needs at most 2 renormalization bytes (sm_bits <= 16)
+    while (i + n <= count && (size_t)(end - p) >= n * 2) {
+        for (size_t j = 0; j < n; j++) {
+            out[i + j] = ra_decode_symbol(sm, &x[j]);
+            while (x[j] < ra_lower) { x[j] = (x[j] << 8) | *p++; }
+        }
+        i += n;
+    }
+    for (size_t j = 0; i < count; j = (j + 1) % n) { // input tail
+        out[i++] = ra_decode_symbol(sm, &x[j]);
+        while (x[j] < ra_lower) { x[j] = (x[j] << 8) | (p < end ? *p++ : 0); }
+    }
+    for (size_t j = 0; j < n; j++) { state[j] = x[j]; }
+    return p;
+}
+
+int32_t ra_decode(const struct static_model* sm, int32_t states,
+                  const uint8_t in[], size_t bytes,
+                  uint8_t out[], size_t count) {
+    if (!ra_valid_states(states)) { return rc_err_invalid; }
+    const size_t n = (size_t)states;
+    if (bytes < n * 4) { return rc_err_data; }
+    uint32_t x[ra_max_states];
+    const uint8_t* p = in;
+    const uint8_t* end = in + bytes;
+    for (size_t j = 0; j < n; j++) {
+        x[j] = (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+               ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        if (x[j] < ra_lower || x[j] >= (uint32_t)ra_lower << 8) {
+            return rc_err_data;
+        }
+        p += 4;
+    }
+    switch (n) {
+        case 1:  p = ra_decode_n(sm, x, p, end, out, count, 1); break;
+        case 2:  p = ra_decode_n(sm, x, p, end, out, count, 2); break;
+        case 4:  p = ra_decode_n(sm, x, p, end, out, count, 4); break;
+        default: p = ra_decode_n(sm, x, p, end, out, count, 8); break;
+    }
+    bool ok = p == end;
+    for (size_t j = 0; j < n; j++) { ok = ok && x[j] == ra_lower; }
+    return ok ? 0 : rc_err_data;
+}
+
+#endif // rc_rans_implementation
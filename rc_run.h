@@ -0,0 +1,139 @@
+#ifndef rc_run_header_included
+#define rc_run_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// Run mode for long runs of a dominant symbol (sparse bitmaps, zero
+// padded records, "Long zeros" of rc_test5())
+//
+// Symbols are coded one at a time with an adaptive compact_model until
+// the last rl_min_run coded symbols are the same. Then the coder
+// switches to run mode: the number of further repeats of that symbol
+// is coded as a single integer with the adaptive bucket model of
+// rc_int.h, the run is skipped (encoder) or filled with memset()
+// (decoder) and the symbol breaking the run (if any) is coded with a
+// separate breaker model over the other n - 1 symbols (the run symbol
+// cannot end its own run; with n == 2 the breaker costs nothing).
+// Both sides switch back to symbol mode after it thus data without
+// runs pays only for rare short runs.
+//
+// Run mode decision depends only on already coded symbols and the
+// mode state is kept between calls. Encoder and decoder must use
+// the same sequence of counts (runs are cut at the end of each array).
+// Symbols inside runs do not update the symbol model.
+
+#include "rc.h"
+#include "rc_int.h"
+
+#define rl_min_run 2 // repeats of the same symbol that start run mode
+
+struct run_model {
+    struct compact_model sym;
+    struct compact_model breaker; // symbols that end runs (n - 1)
+    struct int_model     run;     // lengths of runs (ic_raw)
+    uint32_t             symbol;  // last coded symbol
+    uint32_t             repeats; // number of last coded equal symbols
+    uint32_t             n;       // alphabet size
+};
+
+// rl_decode_array() returns number of decoded symbols (< count on
+// error, e.g. corrupted stream or run longer than the array).
+
+void   rl_init(struct run_model* rl, uint32_t n); // n <= 256
+void   rl_encode_array(struct range_coder* rc, struct run_model* rl,
+                       const uint8_t data[], size_t count);
+size_t rl_decode_array(struct range_coder* rc, struct run_model* rl,
+                       uint8_t data[], size_t count);
+
+#endif // rc_run_header_included
+
+#ifdef rc_run_implementation
+
+#include "unstd.h"
+
+void rl_init(struct run_model* rl, uint32_t n) {
+    memset(rl, 0, sizeof(*rl));
+    cm_init(&rl->sym, n);
+    if (n > 2) { cm_init(&rl->breaker, n - 1); }
+    rl->n = n;
+    (void)ic_init(&rl->run, ic_raw); // never fails for ic_raw
+}
+
+static void rl_encode_breaker(struct range_coder* rc, struct run_model* rl,
+                              uint8_t sym) {
+    // sym != rl->symbol: symbols above the run symbol move down by one
+    if (sym >= rl->n) {
+        if (rc->error == 0) { rc->error = rc_err_invalid; }
+    } else if (rl->n > 2) {
+        const uint8_t b = (uint8_t)(sym > rl->symbol ? sym - 1 : sym);
+        cm_encode(rc, &rl->breaker, b);
+    }
+}
+
+static uint8_t rl_decode_breaker(struct range_coder* rc,
+                                 struct run_model* rl) {
+    const uint8_t b = rl->n > 2 ? cm_decode(rc, &rl->breaker) : 0;
+    return (uint8_t)(b >= rl->symbol ? b + 1 : b);
+}
+
+static inline void rl_coded(struct run_model* rl, uint8_t sym) {
+    rl->repeats = rl->symbol == sym ? rl->repeats + 1 : 1;
+    rl->symbol  = sym;
+}
+
+void rl_encode_array(struct range_coder* rc, struct run_model* rl,
+                     const uint8_t data[], size_t count) {
+    size_t i = 0;
+    while (i < count && rc->error == 0) {
+        if (rl->repeats >= rl_min_run) {
+            const uint8_t s = (uint8_t)rl->symbol;
+            size_t k = i;
+            while (k < count && data[k] == s) { k++; }
+            ic_encode(rc, &rl->run, k - i);
+            i = k;
+            if (i < count) {
+                rl_encode_breaker(rc, rl, data[i]);
+                rl_coded(rl, data[i]);
+                i++;
+            }
+        } else {
+            cm_encode(rc, &rl->sym, data[i]);
+            rl_coded(rl, data[i]);
+            i++;
+        }
+    }
+}
+
+size_t rl_decode_array(struct range_coder* rc, struct run_model* rl,
+                       uint8_t data[], size_t count) {
+    size_t i = 0;
+    while (i < count && rc->error == 0) {
+        if (rl->repeats >= rl_min_run) {
+            const uint64_t run = ic_decode(rc, &rl->run);
+            if (rc->error != 0) { break; }
+            if (run > count - i) {
+                rc->error = rc_err_data;
+                break;
+            }
+            memset(data + i, (uint8_t)rl->symbol, (size_t)run);
+            i += (size_t)run;
+            if (i < count) {
+                const uint8_t sym = rl_decode_breaker(rc, rl);
+                if (rc->error != 0) { break; }
+                data[i++] = sym;
+                rl_coded(rl, sym);
+            }
+        } else {
+            const uint8_t sym = cm_decode(rc, &rl->sym);
+            if (rc->error != 0) { break; }
+            data[i++] = sym;
+            rl_coded(rl, sym);
+        }
+    }
+    return i;
+}
+
+#endif // rc_run_implementation
@@ -0,0 +1,230 @@
+#ifndef rc_simd_header_included
+#define rc_simd_header_included
+
+// Copyright (c) 2024, "Leo" Dmitry Kuznetsov
+// This code and the accompanying materials are made available under the terms
+// of BSD-3 license, which accompanies this distribution. The full text of the
+// license may be found at https://opensource.org/license/bsd-3-clause
+
+// Blocked cumulative frequency model for the 256 symbols alphabet
+//
+// Cumulative frequencies are kept in 16 blocks of 16 symbols: start of
+// each block and start of each symbol inside its block. Both arrays are
+// non decreasing thus decoder finds the symbol (and its interval start)
+// with two 16 lanes SIMD compares instead of the data dependent
+// Fenwick tree descent. Update touches at most 15 + 15 entries.
+//
+// Adaptation (inc, limit, halving rescale) is the same as compact_model
+// and the streams are bit identical with cm_encode()/cm_decode().
+// SIMD implementation (SSE2 or AVX2) is chosen at runtime on x86/x64,
+// other platforms use scalar search.
+
+#include "rc.h"
+
+enum { bm_block = 16 }; // symbols per block
+
+struct blocked_model {
+    uint32_t block[rc_sym_count / bm_block]; // block start
+    uint32_t start[rc_sym_count]; // symbol start relative to its block
+    uint32_t freq[rc_sym_count];
+    uint32_t total;
+    uint32_t inc;   // see compact_model
+    uint32_t limit; // limit + inc < 2^31
+    int32_t  isa;   // search used by bm_decode()
+};
+
+enum { bm_scalar = 0, bm_sse2 = 1, bm_avx2 = 2 };
+
+// bm_init() selects the best supported search for the model.
+// bm_select() limits it to the best supported search <= `isa` and
+// returns it. There is no global state: models can be initialized
+// and used concurrently by different threads.
+
+void    bm_init(struct blocked_model* bm, uint32_t n); // n <= 256
+int32_t bm_select(struct blocked_model* bm, int32_t isa);
+void    bm_update(struct blocked_model* bm, uint8_t sym);
+void    bm_encode(struct range_coder* rc, struct blocked_model* bm,
+                  uint8_t sym);
+uint8_t bm_decode(struct range_coder* rc, struct blocked_model* bm);
+
+#endif // rc_simd_header_included
+
+#ifdef rc_simd_implementation
+
+#include "unstd.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || \
+    defined(_M_IX86) || defined(__i386__)
+#define bm_x86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define bm_target(isa) __attribute__((target(isa)))
+#else
+#define bm_target(isa)
+#endif
+
+static inline uint32_t bm_ctz(uint32_t x) { // x != 0
+    #ifdef _MSC_VER
+        unsigned long i;
+        _BitScanForward(&i, x);
+        return (uint32_t)i;
+    #else
+        return (uint32_t)__builtin_ctz(x);
+    #endif
+}
+
+// index of the last of 16 non decreasing a[i] <= v (a[0] <= v)
+
+static uint32_t bm_search_scalar(const uint32_t a[], uint32_t v) {
+    uint32_t i = 0;
+    for (uint32_t step = bm_block / 2; step != 0; step >>= 1) {
+        if (a[i + step] <= v) { i += step; }
+    }
+    return i;
+}
+
+#ifdef bm_x86
+
+bm_target("sse2")
+static uint32_t bm_search_sse2(const uint32_t a[], uint32_t v) {
+    const __m128i x = _mm_set1_epi32((int32_t)v); // v < 2^31
+    const __m128i* p = (const __m128i*)a;
+    uint32_t gt = 0; // bit i is set when a[i] > v
+    for (uint32_t i = 0; i < bm_block / 4; i++) {
+        const __m128i c = _mm_cmpgt_epi32(_mm_loadu_si128(p + i), x);
+        gt |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(c)) << (i * 4);
+    }
+    return bm_ctz(gt | (1u << bm_block)) - 1;
+}
+
+bm_target("avx2")
+static uint32_t bm_search_avx2(const uint32_t a[], uint32_t v) {
+    const __m256i x = _mm256_set1_epi32((int32_t)v);
+    const __m256i* p = (const __m256i*)a;
+    const __m256i c0 = _mm256_cmpgt_epi32(_mm256_loadu_si256(p + 0), x);
+    const __m256i c1 = _mm256_cmpgt_epi32(_mm256_loadu_si256(p + 1), x);
+    const uint32_t gt = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(c0)) |
+        ((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(c1)) << 8);
+    return bm_ctz(gt | (1u << bm_block)) - 1;
+}
+
+static bool bm_has_avx2(void) {
+    #ifdef _MSC_VER
+        int r[4];
+        __cpuid(r, 0);
+        if (r[0] < 7) { return false; }
+        __cpuid(r, 1);
+        const bool osxsave = (r[2] & (1 << 27)) != 0;
+        const bool avx     = (r[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) { return false; }
+        __cpuidex(r, 7, 0);
+        return (r[1] & (1 << 5)) != 0;
+    #else
+        return __builtin_cpu_supports("avx2");
+    #endif
+}
+
+#endif // bm_x86
+
+int32_t bm_select(struct blocked_model* bm, int32_t isa) {
+    bm->isa = bm_scalar;
+    #ifdef bm_x86
+        if (isa >= bm_avx2 && bm_has_avx2()) {
+            bm->isa = bm_avx2;
+        } else if (isa >= bm_sse2) { // always present on x64
+            bm->isa = bm_sse2;
+        }
+    #else
+        (void)isa;
+    #endif
+    return bm->isa;
+}
+
+static inline uint32_t bm_search(const struct blocked_model* bm,
+                                 const uint32_t a[], uint32_t v) {
+    #ifdef bm_x86
+        if (bm->isa == bm_avx2) { return bm_search_avx2(a, v); }
+        if (bm->isa == bm_sse2) { return bm_search_sse2(a, v); }
+    #endif
+    return bm_search_scalar(a, v);
+}
+
+static void bm_build(struct blocked_model* bm) {
+    uint32_t total = 0;
+    for (size_t b = 0; b < countof(bm->block); b++) {
+        bm->block[b] = total;
+        uint32_t start = 0;
+        for (size_t i = b * bm_block; i < (b + 1) * bm_block; i++) {
+            bm->start[i] = start;
+            start += bm->freq[i];
+        }
+        total += start;
+    }
+    bm->total = total;
+}
+
+void bm_init(struct blocked_model* bm, uint32_t n) {
+    swear(2 <= n && n <= rc_sym_count);
+    bm_select(bm, bm_avx2);
+    for (size_t i = 0; i < countof(bm->freq); i++) {
+        bm->freq[i] = i < n ? 1 : 0;
+    }
+    bm_build(bm);
+    bm->inc   = cm_default_inc;
+    bm->limit = cm_default_limit;
+}
+
+void bm_update(struct blocked_model* bm, uint8_t sym) {
+    assert(bm->inc > 0 && bm->limit < (1u << 31) - bm->inc);
+    const uint32_t inc = bm->inc;
+    const uint32_t b = sym / bm_block;
+    bm->freq[sym] += inc;
+    for (uint32_t i = sym + 1; i < (b + 1) * bm_block; i++) {
+        bm->start[i] += inc;
+    }
+    for (uint32_t i = b + 1; i < countof(bm->block); i++) {
+        bm->block[i] += inc;
+    }
+    bm->total += inc;
+    if (bm->total > bm->limit) { // see cm_rescale()
+        for (size_t i = 0; i < countof(bm->freq); i++) {
+            bm->freq[i] = (bm->freq[i] + 1) / 2;
+        }
+        bm_build(bm);
+    }
+}
+
+void bm_encode(struct range_coder* rc, struct blocked_model* bm,
+               uint8_t sym) {
+    const uint32_t size = bm->freq[sym];
+    if (size == 0) { // symbol is not in the alphabet
+        if (rc->error == 0) { rc->error = rc_err_invalid; }
+    } else {
+        const uint32_t start = bm->block[sym / bm_block] + bm->start[sym];
+        rc_encode_range(rc, start, size, bm->total);
+        bm_update(bm, sym);
+    }
+}
+
+uint8_t bm_decode(struct range_coder* rc, struct blocked_model* bm) {
+    const uint64_t sum = rc_decode_freq(rc, bm->total);
+    if (sum >= bm->total) {
+        if (rc->error == 0) { rc->error = rc_err_data; }
+        return 0;
+    }
+    const uint32_t v = (uint32_t)sum;
+    const uint32_t b = bm_search(bm, bm->block, v);
+    const uint32_t r = v - bm->block[b];
+    const uint32_t sym = b * bm_block +
+                         bm_search(bm, bm->start + b * bm_block, r);
+    rc_decode_range(rc, bm->block[b] + bm->start[sym], bm->freq[sym]);
+    bm_update(bm, (uint8_t)sym);
+    return (uint8_t)sym;
+}
+
+#endif // rc_simd_implementation
@@ -9,6 +9,33 @@
 #include "rc.h"
 #define rc_implementation
 #include "rc.h"
+#include "rc_block.h"
+#define rc_block_implementation
+#include "rc_block.h"
+#include "rc_binary.h"
+#define rc_binary_implementation
+#include "rc_binary.h"
+#include "rc_simd.h"
+#define rc_simd_implementation
+#include "rc_simd.h"
+#define rc_rans_implementation
+#include "rc_rans.h"
+#define rc_interleave_implementation
+#include "rc_interleave.h"
+#define rc_lz_implementation
+#include "rc_lz.h"
+#define rc_int_implementation
+#include "rc_int.h"
+#define rc_run_implementation
+#include "rc_run.h"
+#define rc_context_implementation
+#include "rc_context.h"
+#define rc_ppm_implementation
+#include "rc_ppm.h"
+#define rc_match_implementation
+#include "rc_match.h"
+#define rc_mix_implementation
+#include "rc_mix.h"
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -85,9 +112,7 @@ static inline void shuffle_not_implemented(void) { }
 static void rc_encoder(struct range_coder* rc, struct prob_model * fm,
                        const uint8_t data[], size_t count) {
     rc_init(rc, 0);
-    for (size_t i = 0; i < count && rc->error == 0; i++) {
-        rc_encode(rc, fm, data[i]);
-    }
+    rc_encode_array(rc, fm, data, count);
     rc_flush(rc);
 }
 
@@ -95,9 +120,10 @@ static size_t rc_decoder(struct range_coder* rc, struct prob_model * fm,
                          uint8_t data[], size_t count, int32_t eom) {
     rc->code = 0;
     for (size_t i = 0; i < sizeof(rc->code); i++) {
-        rc->code = (rc->code << 8) + rc->read(rc);
+        rc->code = (rc->code << 8) + rc_in(rc);
     }
     rc_init(rc, rc->code);
+    if (eom < 0) { return rc_decode_array(rc, fm, data, count); }
     size_t i = 0;
     while (i < count && rc->error == 0) {
         uint8_t  sym = rc_decode(rc, fm);
@@ -177,8 +203,7 @@ static void io_alloc(struct range_coder* rc, size_t capacity) {
     io.c = capacity;
     io.bytes = 0;
     io.written = 0;
-    rc->write = io_write;
-    rc->read = io_read;
+    rc_callbacks(rc, io_write, io_read);
     checksum_init();
 }
 
@@ -474,7 +499,7 @@ static int32_t rc_test6(void) {
     io_rewind();
     rc->code = 0;
     for (size_t i = 0; i < sizeof(rc->code); i++) {
-        rc->code = (rc->code << 8) + rc->read(rc);
+        rc->code = (rc->code << 8) + rc_in(rc);
     }
     rc_init(rc, rc->code);
     uint8_t*  out_text = allocate(n);
@@ -553,6 +578,45 @@ static int32_t rc_test7(void) { // fuzzing: corrupted stream
     return 0;
 }
 
+static int32_t rb_round_trip(const uint8_t in[], uint8_t out[], size_t n,
+                             const struct rb_options* o) {
+    const size_t bound = rb_bound(n, o);
+    uint8_t* data = allocate(bound);
+    size_t written = 0;
+    size_t k = 0;
+    uint64_t t0 = nanoseconds();
+    int32_t r = rb_compress(in, n, data, bound, &written, o);
+    uint64_t t1 = nanoseconds();
+    if (r == 0) { r = rb_decompress(data, written, out, n, &k, o); }
+    uint64_t t2 = nanoseconds();
+    if (r == 0 && (k != n || memcmp(in, out, n) != 0)) { r = rc_err_data; }
+    if (rc_verbose) {
+        printf("threads: %d chunk: %lldKB %lld to %lld bytes "
+               "compress: %.1f MB/s decompress: %.1f MB/s\n",
+               rb_threads(o, INT32_MAX), (uint64_t)rb_chunk_size(o) / 1024,
+               (uint64_t)n, (uint64_t)written,
+               n * 1000.0 / (t1 - t0 + 1), n * 1000.0 / (t2 - t1 + 1));
+    }
+    free(data);
+    swear(r == 0);
+    return r;
+}
+
+static int32_t rb_methods(const uint8_t data[], size_t written,
+                          uint8_t methods[], uint32_t count) {
+    // methods of the `count` chunks of the frame
+    struct rb_info info;
+    int32_t r = rb_info(data, written, &info);
+    if (r == 0 && info.chunks != count) { r = rc_err_data; }
+    uint64_t offset = rb_header_size;
+    for (uint32_t i = 0; i < count && r == 0; i++) {
+        const uint8_t* h = data + offset;
+        methods[i] = h[16];
+        offset += rb_chunk_header + rb_get32(h + 4);
+    }
+    return r;
+}
+
 static int32_t rc_test8(void) { // huge 1GB test
     int32_t r = 0;
     #ifndef DEBUG // only in release mode, too slow for debug
@@ -571,14 +635,1946 @@ static int32_t rc_test8(void) { // huge 1GB test
     size_t k = decode(out, n, symbols, -1);
     swear(rc->error == 0 && k == n && ecs == io.checksum);
     r = rc_cmp(in, out, n, ecs);
+    io_free();
+    // block parallel compression of the same data scaling with cores
+    const int32_t cores = rb_cores();
+    for (int32_t threads = rc_verbose ? 1 : cores; threads <= cores && r == 0;
+         threads = threads < cores ? min(threads * 2, cores) : cores + 1) {
+        struct rb_options o = { .chunk = 16 * 1024 * 1024, .threads = threads };
+        r = rb_round_trip(in, out, n, &o);
+    }
     free(out);
     free(in);
-    io_free();
     rc_exit();
     #endif
     return r;
 }
 
+static uint8_t io_span[333]; // odd size to test span boundaries
+
+static void io_flush(struct range_coder* rc) { // drain span into `io`
+    for (size_t i = 0; i < rc->next; i++) { io_write(rc, rc->data[i]); }
+    rc->next = 0;
+}
+
+static void io_refill(struct range_coder* rc) { // refill span from `io`
+    size_t k = 0;
+    while (k < countof(io_span) && io.bytes < io.written) {
+        io_span[k++] = io_read(rc);
+    }
+    rc_span(rc, io_span, k);
+}
+
+static int32_t rc_test9(void) {
+    rc_enter("Buffered");
+    enum { symbols = 256 };
+    enum { n = 64 * 1024 };
+    io_alloc(rc, n * 2 + 8);
+    uint64_t zips[symbols];
+    for (size_t i = 0; i < countof(zips); i++) { zips[i] = i + 1; }
+    uint8_t* in = allocate(n);
+    rc_fill(in, n, zips, countof(zips), symbols);
+    uint64_t ecs = encode(in, n, symbols); // per byte write() reference
+    const size_t bytes = io.written;
+    uint8_t* ref = allocate(bytes);
+    memcpy(ref, io.data, bytes);
+    // encoder: buffered into io_span[] with flush() into `io`
+    io.written = 0;
+    checksum_init();
+    rc->flush = io_flush;
+    rc_span(rc, io_span, countof(io_span));
+    swear(encode(in, n, symbols) == ecs);
+    swear(io.written == bytes && memcmp(io.data, ref, bytes) == 0);
+    // decoder: buffered from io_span[] with refill() from `io`
+    rc->refill = io_refill;
+    rc_span(rc, io_span, 0); // empty span: first rc_in() calls refill()
+    uint8_t* out = allocate(n);
+    size_t k = decode(out, n, symbols, -1);
+    swear(rc->error == 0 && k == n && ecs == io.checksum);
+    int32_t r = rc_cmp(in, out, n, ecs);
+    // decoder: whole in memory input span without refill()
+    rc->refill = null;
+    rc_span(rc, ref, bytes);
+    pm_init(pm, symbols);
+    memset(out, 0, n);
+    k = rc_decoder(rc, pm, out, n, -1);
+    swear(rc->error == 0 && k == n && memcmp(in, out, n) == 0);
+    // per symbol rc_encode()/rc_decode() are bit identical to arrays
+    uint8_t* per = allocate(bytes);
+    pm_init(pm, symbols);
+    rc_callbacks(rc, null, null);
+    rc_span(rc, per, bytes);
+    rc_init(rc, 0);
+    for (size_t i = 0; i < n; i++) { rc_encode(rc, pm, in[i]); }
+    rc_flush(rc);
+    swear(rc->error == 0 && rc->next == bytes);
+    swear(memcmp(per, ref, bytes) == 0);
+    pm_init(pm, symbols);
+    memset(out, 0, n);
+    rc_span(rc, per, bytes);
+    uint64_t code = 0;
+    for (size_t i = 0; i < sizeof(code); i++) {
+        code = (code << 8) + rc_in(rc);
+    }
+    rc_init(rc, code);
+    for (size_t i = 0; i < n; i++) { out[i] = rc_decode(rc, pm); }
+    swear(rc->error == 0 && memcmp(in, out, n) == 0);
+    free(per);
+    // symbol outside of the model alphabet stops rc_encode_array()
+    static const uint8_t outside[] = { 0, 1, 3, 2, 7, 1, 0 };
+    pm_init(pm, 4);
+    rc_span(rc, out, n);
+    rc_init(rc, 0);
+    rc_encode_array(rc, pm, outside, countof(outside));
+    swear(rc->error == rc_err_invalid);
+    swear(pm_total_freq(pm) == 4 + 4); // four symbols coded before `7`
+    rc->error = 0;
+    free(out);
+    free(ref);
+    free(in);
+    io_free();
+    rc_exit();
+    return r;
+}
+
+static int32_t rc_test10(void) {
+    rc_enter("Parallel");
+    enum { symbols = 256 };
+    enum { n = 5 * 1024 * 1024 + 3 };
+    uint64_t zips[symbols];
+    for (size_t i = 0; i < countof(zips); i++) { zips[i] = i + 1; }
+    uint8_t* in = allocate(n);
+    rc_fill(in, n, zips, countof(zips), symbols);
+    uint8_t* out = allocate(n);
+    struct rb_options o = { .chunk = 1024 * 1024, .threads = 0 };
+    int32_t r = rb_round_trip(in, out, n, &o);
+    o.threads = 3; // more chunks than threads
+    if (r == 0) { r = rb_round_trip(in, out, n, &o); }
+    o.chunk = 0; // single default size chunk
+    if (r == 0) { r = rb_round_trip(in, out, n, &o); }
+    free(out);
+    free(in);
+    rc_exit();
+    return r;
+}
+
+static int32_t rc_test11(void) {
+    rc_enter("Framed");
+    enum { bits = 5 };
+    enum { symbols = 1 << bits };
+    enum { n = 3 * 1024 * 1024 + 5 };
+    uint64_t lucas[symbols] = { 2, 1 };
+    for (size_t i = 2; i < countof(lucas); i++) {
+        lucas[i] = lucas[i - 1] + lucas[i - 2];
+    }
+    uint8_t* in = allocate(n);
+    rc_fill(in, n, lucas, countof(lucas), symbols);
+    struct rb_options o = { .chunk = 256 * 1024, .symbols = symbols };
+    const size_t bound = rb_bound(n, &o);
+    uint8_t* data = allocate(bound);
+    size_t written = 0;
+    int32_t r = rb_compress(in, n, data, bound, &written, &o);
+    swear(r == 0);
+    struct rb_info info;
+    r = rb_info(data, written, &info);
+    swear(r == 0 && info.bytes == n && info.symbols == symbols &&
+          info.chunk == o.chunk && info.chunks == (n + o.chunk - 1) / o.chunk);
+    // seek and decode random ranges of the original data
+    uint8_t* out = allocate(n);
+    for (int i = 0; i < 16 && r == 0; i++) {
+        const size_t offset = (size_t)(n * rand64(&seed));
+        const size_t count  = (size_t)((n - offset) * rand64(&seed) / 4);
+        r = rb_read(data, written, offset, out, count);
+        swear(r == 0 && memcmp(in + offset, out, count) == 0);
+    }
+    swear(rb_read(data, written, n - 1, out, 2) == rc_err_range);
+    // corrupted payload, chunk header or index must be detected
+    const size_t ix[] = { rb_header_size + rb_chunk_header + 7,
+                          rb_header_size + 1, (size_t)info.index + 9,
+                          written - 3 };
+    for (size_t i = 0; i < countof(ix) && r == 0; i++) {
+        data[ix[i]] ^= 0x5A;
+        size_t k = 0;
+        swear(rb_decompress(data, written, out, n, &k, &o) != 0 && k == 0);
+        data[ix[i]] ^= 0x5A;
+    }
+    size_t k = 0;
+    if (r == 0) { r = rb_decompress(data, written, out, n, &k, &o); }
+    swear(r == 0 && k == n && memcmp(in, out, n) == 0);
+    free(out);
+    free(data);
+    free(in);
+    rc_exit();
+    return r;
+}
+
+static size_t rb_piece(size_t limit) { // random piece size in [1..limit]
+    return 1 + (size_t)(rand64(&seed) * (double)limit) % limit;
+}
+
+static int32_t rb_stream_round_trip(const uint8_t data[], size_t bytes,
+                                    uint8_t out[], size_t n, size_t* written,
+                                    size_t piece) {
+    // feeds stream decoder with random pieces of input and output
+    struct rb_stream s;
+    int32_t r = rb_stream_decoder(&s);
+    while (r == 0 && !s.end) {
+        const size_t in  = (size_t)s.total_in;
+        const size_t at  = (size_t)s.total_out;
+        s.next_in   = data + in;
+        s.avail_in  = min(bytes - in, rb_piece(piece));
+        s.next_out  = out + at;
+        s.avail_out = min(n - at, rb_piece(piece));
+        r = rb_stream_decode(&s);
+        if (r == 0 && !s.end && s.avail_in > 0 && s.avail_out > 0) {
+            r = rc_err_data; // no progress with input and output available
+        } else if (r == 0 && !s.end && s.total_in == bytes) {
+            r = rc_err_data; // truncated
+        }
+    }
+    *written = (size_t)s.total_out;
+    rb_stream_fini(&s);
+    return r;
+}
+
+static int32_t rc_test12(void) {
+    rc_enter("Streaming");
+    enum { n = 1024 * 1024 + 7 };
+    uint64_t freq[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8_t* in = allocate(n);
+    rc_fill(in, n, freq, countof(freq), 256);
+    struct rb_options o = { .chunk = 64 * 1024 + 3 };
+    const size_t bound = rb_bound(n, &o);
+    uint8_t* data = allocate(bound);
+    uint8_t* out  = allocate(n);
+    int32_t r = 0;
+    for (size_t piece = 1000; piece < n && r == 0; piece *= 10) {
+        // encode random pieces of input into random pieces of output
+        struct rb_stream s;
+        r = rb_stream_encoder(&s, &o);
+        while (r == 0 && !s.end) {
+            const size_t at = (size_t)s.total_in;
+            s.next_in   = in + at;
+            s.avail_in  = min(n - at, rb_piece(piece));
+            s.next_out  = data + s.total_out;
+            s.avail_out = min(bound - (size_t)s.total_out, rb_piece(piece));
+            r = rb_stream_encode(&s, s.total_in + s.avail_in == n);
+        }
+        const size_t written = (size_t)s.total_out;
+        swear(r == 0 && s.total_in == n && written <= bound);
+        rb_stream_fini(&s);
+        // frame without index: sequential and random access decoding
+        struct rb_info info;
+        r = rb_info(data, written, &info);
+        swear(r == 0 && !info.indexed && info.bytes == n &&
+              info.chunks == (n + o.chunk - 1) / o.chunk);
+        size_t k = 0;
+        r = rb_decompress(data, written, out, n, &k, &o);
+        swear(r == 0 && k == n && memcmp(in, out, n) == 0);
+        memset(out, 0, n);
+        r = rb_stream_round_trip(data, written, out, n, &k, piece);
+        swear(r == 0 && k == n && memcmp(in, out, n) == 0);
+        const size_t offset = (size_t)(n * rand64(&seed));
+        const size_t count  = (size_t)((n - offset) * rand64(&seed));
+        r = rb_read(data, written, offset, out, count);
+        swear(r == 0 && memcmp(in + offset, out, count) == 0);
+        // corrupted payload and truncated stream must be detected
+        data[written / 2] ^= 0x5A;
+        swear(rb_stream_round_trip(data, written, out, n, &k, piece) != 0);
+        data[written / 2] ^= 0x5A;
+        swear(rb_stream_round_trip(data, written - 1, out, n, &k,
+                                   piece) != 0);
+        if (rc_verbose) {
+            printf("piece: %d compressed: %d\n", (int)piece, (int)written);
+        }
+    }
+    // stream decoder accepts indexed frames produced by rb_compress()
+    size_t written = 0;
+    if (r == 0) { r = rb_compress(in, n, data, bound, &written, &o); }
+    size_t k = 0;
+    if (r == 0) { r = rb_stream_round_trip(data, written, out, n, &k, n); }
+    swear(r == 0 && k == n && memcmp(in, out, n) == 0);
+    // corrupted header, index and footer of indexed frame are detected
+    struct rb_info info;
+    swear(rb_info(data, written, &info) == 0 && info.indexed);
+    uint8_t* f = data + written - rb_footer_size;
+    uint8_t* corrupt[] = {
+        data + 5,                                  // symbols = 1
+        data + info.index + rb_index_entry + 3,    // chunk offset
+        data + info.index + rb_index_entry + 8 + 4, // compressed size
+        f + 0,                                     // index offset
+        f + 8                                      // number of chunks
+    };
+    for (size_t i = 0; i < countof(corrupt); i++) {
+        const uint8_t b = *corrupt[i];
+        *corrupt[i] = i == 0 ? 0 : b ^ 0x01;
+        swear(rb_stream_round_trip(data, written, out, n, &k, n) ==
+              rc_err_data);
+        *corrupt[i] = b;
+    }
+    swear(rb_stream_round_trip(data, written, out, n, &k, 1000) == 0);
+    free(out);
+    free(data);
+    free(in);
+    rc_exit();
+    return r;
+}
+
+static uint64_t rc_code(struct range_coder* rc) { // first 8 bytes
+    uint64_t code = 0;
+    for (size_t i = 0; i < sizeof(code); i++) {
+        code = (code << 8) + rc_in(rc);
+    }
+    return code;
+}
+
+static size_t cm_encoder(struct compact_model* cm, const uint8_t in[],
+                         size_t n, uint32_t symbols) {
+    io.written = 0;
+    checksum_init();
+    rc_init(rc, 0);
+    cm_init(cm, symbols);
+    for (size_t i = 0; i < n; i++) { cm_encode(rc, cm, in[i]); }
+    rc_flush(rc);
+    swear(rc->error == 0);
+    return io.written;
+}
+
+static size_t cm_decoder(struct compact_model* cm, uint8_t out[],
+                         size_t n, uint32_t symbols) {
+    io_rewind();
+    rc_init(rc, rc_code(rc));
+    cm_init(cm, symbols);
+    size_t k = 0;
+    while (k < n && rc->error == 0) { out[k++] = cm_decode(rc, cm); }
+    return rc->error == 0 ? k : 0;
+}
+
+static int32_t rc_test13(void) {
+    rc_enter("Compact");
+    enum { symbols = 64 };
+    enum { n = 1024 * 1024 };
+    enum { block = 32 * 1024 }; // nonstationary: alphabet halves alternate
+    io_alloc(rc, n * 2 + 8);
+    struct compact_model* cm = allocate(sizeof(struct compact_model));
+    // derived frequencies must survive updates and rescaling
+    uint32_t freq[symbols];
+    cm_init(cm, symbols);
+    cm->limit = 1024;
+    for (size_t i = 0; i < countof(freq); i++) { freq[i] = 1; }
+    for (int i = 0; i < 10000; i++) {
+        const uint8_t sym = (uint8_t)(random64(&seed) % (symbols / 4));
+        freq[sym] += cm->inc;
+        uint32_t total = 0;
+        for (size_t j = 0; j < countof(freq); j++) { total += freq[j]; }
+        if (total > cm->limit) {
+            for (size_t j = 0; j < countof(freq); j++) {
+                freq[j] = (freq[j] + 1) / 2;
+            }
+        }
+        cm_update(cm, sym);
+        swear(cm_freq(cm, sym) == freq[sym]);
+    }
+    for (size_t i = 0; i < countof(freq); i++) {
+        swear(cm_freq(cm, (uint8_t)i) == freq[i]);
+    }
+    uint64_t zips[symbols / 2];
+    for (size_t i = 0; i < countof(zips); i++) { zips[i] = i + 1; }
+    uint8_t* in = allocate(n);
+    rc_fill(in, n, zips, countof(zips), symbols / 2);
+    for (size_t i = 0; i < n; i++) {
+        if ((i / block) % 2 == 1) { in[i] += symbols / 2; }
+    }
+    // rc_encode_range() with prob_model is bit identical to rc_encode()
+    const uint64_t ecs = encode(in, n, symbols);
+    const size_t bytes = io.written;
+    io.written = 0;
+    checksum_init();
+    rc_init(rc, 0);
+    pm_init(pm, symbols);
+    for (size_t i = 0; i < n; i++) {
+        rc_encode_range(rc, pm_sum_of(pm, in[i]), pm->freq[in[i]],
+                        pm_total_freq(pm));
+        pm_update(pm, in[i], 1);
+    }
+    rc_flush(rc);
+    swear(io.written == bytes && io.checksum == ecs);
+    // compact model keeps adapting and beats frozen 64 bit counters
+    const size_t written = cm_encoder(cm, in, n, symbols);
+    if (rc_verbose) {
+        printf("prob_model: %d compact_model: %d bytes\n",
+               (int)bytes, (int)written);
+    }
+    swear(written < bytes);
+    uint8_t* out = allocate(n);
+    size_t k = cm_decoder(cm, out, n, symbols);
+    swear(k == n && memcmp(in, out, n) == 0);
+    // corrupted input must not crash and is either detected or garbled
+    io.data[io.written / 2] ^= 0x5A;
+    k = cm_decoder(cm, out, n, symbols);
+    swear(k < n || memcmp(in, out, n) != 0);
+    free(out);
+    free(in);
+    free(cm);
+    io_free();
+    rc_exit();
+    return 0;
+}
+
+pm_declare(1)
+pm_declare(2)
+pm_declare(4)
+
+// encodes in[] with struct prob_model_##bits, compares the stream with
+// the prob_model reference and decodes it back
+
+#define rc_small(bits, in, out, n, r) do {                                  \
+    io.written = 0;                                                         \
+    checksum_init();                                                        \
+    uint64_t t = nanoseconds();                                             \
+    const uint64_t ecs = encode(in, n, 1u << (bits));                       \
+    const uint64_t reference = nanoseconds() - t;                           \
+    const size_t bytes = io.written;                                        \
+    struct prob_model_##bits small;                                         \
+    io.written = 0;                                                         \
+    checksum_init();                                                        \
+    t = nanoseconds();                                                      \
+    rc_init(rc, 0);                                                         \
+    pm_init_##bits(&small);                                                 \
+    for (size_t i = 0; i < n; i++) { rc_encode_##bits(rc, &small, in[i]); } \
+    rc_flush(rc);                                                           \
+    const uint64_t encoding = nanoseconds() - t;                            \
+    swear(rc->error == 0 && io.written == bytes && io.checksum == ecs);     \
+    io_rewind();                                                            \
+    rc_init(rc, rc_code(rc));                                               \
+    pm_init_##bits(&small);                                                 \
+    for (size_t i = 0; i < n; i++) { out[i] = rc_decode_##bits(rc, &small); }\
+    r = rc->error == 0 ? rc_cmp(in, out, n, ecs) : rc->error;               \
+    if (rc_verbose) {                                                       \
+        printf("bits: %d sizeof(model) %d:%d encode ns/symbol %.1f:%.1f\n", \
+               bits, (int)sizeof(small), (int)sizeof(*pm),                  \
+               (double)encoding / n, (double)reference / n);                \
+    }                                                                       \
+} while (0)
+
+static int32_t rc_test14(void) {
+    rc_enter("Small");
+    enum { n = 1024 * 1024 };
+    io_alloc(rc, n * 2 + 8);
+    uint64_t freq[16] = { 1, 3, 7, 11, 13, 17, 19, 23,
+                          29, 31, 37, 41, 43, 47, 53, 59 };
+    uint8_t* in  = allocate(n);
+    uint8_t* out = allocate(n);
+    int32_t r = 0;
+    rc_fill(in, n, freq, 2, 2);
+    rc_small(1, in, out, n, r);
+    if (r == 0) {
+        rc_fill(in, n, freq, 4, 4);
+        rc_small(2, in, out, n, r);
+    }
+    if (r == 0) {
+        rc_fill(in, n, freq, 16, 16);
+        rc_small(4, in, out, n, r);
+    }
+    // symbol outside of the alphabet is rejected at runtime
+    struct prob_model_2 small;
+    pm_init_2(&small);
+    io.written = 0;
+    rc_init(rc, 0);
+    rc_encode_2(rc, &small, 4);
+    swear(rc->error == rc_err_invalid && small.tree[3] == 4);
+    pm_update_2(&small, 255, 1);
+    swear(small.tree[3] == 4);
+    rc->error = 0;
+    free(out);
+    free(in);
+    io_free();
+    rc_exit();
+    return r;
+}
+
+static int32_t rc_test15(void) {
+    rc_enter("Binary");
+    enum { symbols = 256 };
+    enum { n = 1024 * 1024 };
+    io_alloc(rc, n * 2 + 8);
+    uint64_t zips[symbols];
+    for (size_t i = 0; i < countof(zips); i++) { zips[i] = i + 1; }
+    uint8_t* in  = allocate(n);
+    uint8_t* out = allocate(n);
+    rc_fill(in, n, zips, countof(zips), symbols);
+    encode(in, n, symbols); // prob_model reference size
+    const size_t reference = io.written;
+    // bit tree coding of 8 bit symbols
+    struct bit_tree* bt = allocate(sizeof(struct bit_tree));
+    io.written = 0;
+    checksum_init();
+    uint64_t t = nanoseconds();
+    rc_init(rc, 0);
+    bc_tree_init(bt);
+    for (size_t i = 0; i < n; i++) { bc_tree_encode(rc, bt, in[i]); }
+    rc_flush(rc);
+    t = nanoseconds() - t;
+    const uint64_t ecs = io.checksum;
+    io_rewind();
+    rc_init(rc, rc_code(rc));
+    bc_tree_init(bt);
+    for (size_t i = 0; i < n; i++) { out[i] = bc_tree_decode(rc, bt); }
+    swear(rc->error == 0);
+    int32_t r = rc_cmp(in, out, n, ecs);
+    if (rc_verbose) {
+        printf("bit tree: %d prob_model: %d bytes encode: %.1f ns/symbol\n",
+               (int)io.written, (int)reference, (double)t / n);
+    }
+    // binary flags mixed with prob_model and compact_model symbols
+    struct compact_model* cm = allocate(sizeof(struct compact_model));
+    uint16_t flag[2];
+    io.written = 0;
+    checksum_init();
+    rc_init(rc, 0);
+    pm_init(pm, symbols);
+    cm_init(cm, symbols);
+    bc_init(flag, countof(flag));
+    for (size_t i = 0; i < n; i++) {
+        const bool odd = in[i] & 1;
+        bc_encode(rc, &flag[i & 1], odd);
+        if (odd) {
+            rc_encode(rc, pm, in[i]);
+        } else {
+            cm_encode(rc, cm, in[i]);
+        }
+    }
+    rc_flush(rc);
+    swear(rc->error == 0);
+    const uint64_t mcs = io.checksum;
+    io_rewind();
+    rc_init(rc, rc_code(rc));
+    pm_init(pm, symbols);
+    cm_init(cm, symbols);
+    bc_init(flag, countof(flag));
+    memset(out, 0, n);
+    for (size_t i = 0; i < n && rc->error == 0; i++) {
+        const bool odd = bc_decode(rc, &flag[i & 1]);
+        out[i] = odd ? rc_decode(rc, pm) : cm_decode(rc, cm);
+    }
+    swear(rc->error == 0);
+    if (r == 0) { r = rc_cmp(in, out, n, mcs); }
+    free(cm);
+    free(bt);
+    free(out);
+    free(in);
+    io_free();
+    rc_exit();
+    return r;
+}
+
+static int32_t rc_static(const uint8_t in[], uint8_t out[], size_t n,
+                         uint32_t symbols) {
+    io.written = 0;
+    checksum_init();
+    encode(in, n, symbols); // adaptive reference
+    const size_t adaptive = io.written;
+    struct static_model* sm = allocate(sizeof(struct static_model));
+    io.written = 0;
+    checksum_init();
+    uint64_t t = nanoseconds();
+    uint64_t histogram[rc_sym_count] = {0};
+    sm_histogram(histogram, in, n);
+    swear(sm_init(sm, histogram) == 0);
+    rc_init(rc, 0);
+    sm_write(rc, sm);
+    const size_t table = io.written;
+    sm_encode_array(rc, sm, in, n);
+    rc_flush(rc);
+    t = nanoseconds() - t;
+    swear(rc->error == 0);
+    const uint64_t scs = io.checksum;
+    io_rewind();
+    memset(sm, 0, sizeof(*sm));
+    uint64_t d = nanoseconds();
+    rc_init(rc, rc_code(rc));
+    sm_read(rc, sm);
+    size_t k = rc->error == 0 ? sm_decode_array(rc, sm, out, n) : 0;
+    d = nanoseconds() - d;
+    swear(rc->error == 0 && k == n);
+    int32_t r = rc_cmp(in, out, n, scs);
+    if (rc_verbose) {
+        printf("static: %d (table: %d) adaptive: %d bytes "
+               "encode: %.1f decode: %.1f ns/symbol\n", (int)io.written,
+               (int)table, (int)adaptive, (double)t / n, (double)d / n);
+    }
+    free(sm);
+    return r;
+}
+
+static int32_t rc_test16(void) {
+    rc_enter("Static");
+    enum { n = 2 * 1024 * 1024 };
+    io_alloc(rc, n * 2 + 8);
+    uint64_t lucas[32] = { 2, 1 };
+    for (size_t i = 2; i < countof(lucas); i++) {
+        lucas[i] = lucas[i - 1] + lucas[i - 2];
+    }
+    uint64_t zips[256];
+    for (size_t i = 0; i < countof(zips); i++) { zips[i] = i + 1; }
+    uint8_t* in  = allocate(n);
+    uint8_t* out = allocate(n);
+    rc_fill(in, n, lucas, countof(lucas), countof(lucas));
+    int32_t r = rc_static(in, out, n, countof(lucas));
+    if (r == 0) {
+        rc_fill(in, n, zips, countof(zips), countof(zips));
+        r = rc_static(in, out, n, countof(zips));
+    }
+    if (r == 0) { // single symbol
+        memset(in, 0xA5, n);
+        r = rc_static(in, out, n, countof(zips));
+    }
+    uint64_t histogram[rc_sym_count] = {0};
+    struct static_model* sm = allocate(sizeof(struct static_model));
+    swear(sm_init(sm, histogram) == rc_err_invalid);
+    free(sm);
+    free(out);
+    free(in);
+    io_free();
+    rc_exit();
+    return r;
+}
+
+static int32_t rc_test17(void) {
+    rc_enter("SIMD");
+    enum { symbols = 256 };
+    enum { n = 1024 * 1024 };
+    io_alloc(rc, n * 2 + 8);
+    uint64_t zips[symbols];
+    for (size_t i = 0; i < countof(zips); i++) { zips[i] = i + 1; }
+    uint8_t* in  = allocate(n);
+    uint8_t* out = allocate(n);
+    rc_fill(in, n, zips, countof(zips), symbols);
+    struct compact_model* cm = allocate(sizeof(struct compact_model));
+    const size_t bytes = cm_encoder(cm, in, n, symbols); // reference
+    const uint64_t ecs = io.checksum;
+    uint64_t t = nanoseconds();
+    swear(cm_decoder(cm, out, n, symbols) == n);
+    const uint64_t reference = nanoseconds() - t;
+    struct blocked_model* bm = allocate(sizeof(struct blocked_model));
+    int32_t r = 0;
+    for (int32_t isa = bm_avx2; isa >= bm_scalar && r == 0; isa--) {
+        io.written = 0;
+        checksum_init();
+        rc_init(rc, 0);
+        bm_init(bm, symbols);
+        for (size_t i = 0; i < n; i++) { bm_encode(rc, bm, in[i]); }
+        rc_flush(rc);
+        swear(rc->error == 0 && io.written == bytes && io.checksum == ecs);
+        io_rewind();
+        memset(out, 0, n);
+        t = nanoseconds();
+        rc_init(rc, rc_code(rc));
+        bm_init(bm, symbols);
+        const int32_t selected = bm_select(bm, isa);
+        for (size_t i = 0; i < n; i++) { out[i] = bm_decode(rc, bm); }
+        t = nanoseconds() - t;
+        swear(rc->error == 0);
+        r = rc_cmp(in, out, n, ecs);
+        if (rc_verbose) {
+            printf("isa: %d decode: %.1f compact_model: %.1f ns/symbol\n",
+                   selected, (double)t / n, (double)reference / n);
+        }
+    }
+    free(bm);
+    free(cm);
+    free(out);
+    free(in);
+    io_free();
+    rc_exit();
+    return r;
+}
+
+static double mb_per_s(size_t n, uint64_t ns) {
+    return n / (1024.0 * 1024.0) / (ns / 1e9 + 1e-9);
+}
+
+// rc_round_trip() encodes n values of in[] into data[] with the global rc,
+// decodes them back into out[] and compares. Codec callbacks code whole
+// arrays, reset() (may be null) returns the model to its initial state
+// before decoding.
+
+struct rc_codec {
+    void* that; // model
+    void (*encode)(void* that, const void* in, size_t n);
+    void (*decode)(void* that, void* out, size_t n);
+    void (*reset)(void* that);
+    size_t size; // bytes per value
+};
+
+struct rc_trip {
+    size_t   bytes;  // encoded
+    uint64_t encode; // nanoseconds
+    uint64_t decode; // nanoseconds
+};
+
+static size_t rc_encoded(const struct rc_codec* c, const void* in, size_t n,
+                         uint8_t* data, size_t capacity) {
+    rc_callbacks(rc, null, null);
+    rc_span(rc, data, capacity);
+    rc_init(rc, 0);
+    c->encode(c->that, in, n);
+    rc_flush(rc);
+    return rc->next;
+}
+
+static void rc_decoded(const struct rc_codec* c, void* out, size_t n,
+                       uint8_t* data, size_t bytes) {
+    // after rc_reset() of the model
+    rc_span(rc, data, bytes);
+    rc_init(rc, rc_code(rc));
+    c->decode(c->that, out, n);
+}
+
+static void rc_reset(const struct rc_codec* c, void* out, size_t n) {
+    if (c->reset != null) { c->reset(c->that); }
+    memset(out, 0, n * c->size);
+}
+
+static struct rc_trip rc_round_trip(const struct rc_codec* c,
+                                    const void* in, void* out, size_t n,
+                                    uint8_t* data, size_t capacity) {
+    struct rc_trip t = {0};
+    t.encode = nanoseconds();
+    t.bytes = rc_encoded(c, in, n, data, capacity);
+    t.encode = nanoseconds() - t.encode;
+    swear(rc->error == 0);
+    rc_reset(c, out, n); // not timed
+    t.decode = nanoseconds();
+    rc_decoded(c, out, n, data, t.bytes);
+    t.decode = nanoseconds() - t.decode;
+    swear(rc->error == 0 && memcmp(in, out, n * c->size) == 0);
+    return t;
+}
+
+static void rc_corrupted(const struct rc_codec* c, const void* in, void* out,
+                         size_t n, uint8_t* data, size_t capacity) {
+    // corrupted input is detected or decodes to different data
+    const size_t written = rc_encoded(c, in, n, data, capacity);
+    swear(rc->error == 0);
+    data[written / 2] ^= 0x5A;
+    rc_reset(c, out, n);
+    rc_decoded(c, out, n, data, written);
+    swear(rc->error != 0 || memcmp(in, out, n * c->size) != 0);
+}
+
+static void rc_report(const char* name, const struct rc_codec* c, size_t n,
+                      const struct rc_trip* t) {
+    if (rc_verbose && n > 0) {
+        const size_t bytes = n * c->size;
+        printf("%-24s %8d bytes %5.1f%% %6.3f bpv %7.1f %7.1f MB/s\n",
+               name, (int)t->bytes, t->bytes * 100.0 / bytes,
+               t->bytes * 8.0 / n, mb_per_s(bytes, t->encode),
+               mb_per_s(bytes, t->decode));
+    }
+}
+
+// per codec callbacks of rc_round_trip()
+
+static void rc_pm_encode(void* that, const void* in, size_t n) {
+    (void)that;
+    rc_encode_array(rc, pm, (const uint8_t*)in, n);
+}
+
+static void rc_pm_decode(void* that, void* out, size_t n) {
+    (void)that;
+    rc_decode_array(rc, pm, (uint8_t*)out, n);
+}
+
+static void rc_pm_reset(void* that) { pm_init(pm, *(uint32_t*)that); }
+
+static struct rc_codec rc_pm_codec(uint32_t* symbols) {
+    pm_init(pm, *symbols);
+    return (struct rc_codec){ symbols, rc_pm_encode, rc_pm_decode,
+                              rc_pm_reset, 1 };
+}
+
+static int32_t rc_rans_vs_range(const char* name, const uint8_t in[],
+                                uint8_t out[], size_t n, uint32_t symbols,
+                                uint8_t* data, size_t capacity) {
+    // adaptive range coder
+    const struct rc_codec c = rc_pm_codec(&symbols);
+    const struct rc_trip t = rc_round_trip(&c, in, out, n, data, capacity);
+    if (rc_verbose) {
+        printf("%-5s range   %8d bytes %5.1f%% %7.1f %7.1f MB/s\n", name,
+               (int)t.bytes, t.bytes * 100.0 / n, mb_per_s(n, t.encode),
+               mb_per_s(n, t.decode));
+    }
+    // static rANS with 1, 2, 4, 8 interleaved states
+    struct static_model* sm = allocate(sizeof(struct static_model));
+    int32_t r = 0;
+    for (int32_t states = 1; states <= ra_max_states && r == 0; states *= 2) {
+        uint64_t e = nanoseconds();
+        uint64_t histogram[rc_sym_count] = {0};
+        sm_histogram(histogram, in, n);
+        swear(sm_init(sm, histogram) == 0);
+        const size_t table = ra_put_table(sm, data);
+        size_t written = 0;
+        r = ra_encode(sm, states, in, n, data + table, capacity - table,
+                      &written);
+        e = nanoseconds() - e;
+        memset(out, 0, n);
+        memset(sm, 0, sizeof(*sm));
+        uint64_t d = nanoseconds();
+        swear(ra_get_table(sm, data, table + written) == table);
+        if (r == 0) {
+            r = ra_decode(sm, states, data + table, written, out, n);
+        }
+        d = nanoseconds() - d;
+        swear(r == 0 && memcmp(in, out, n) == 0);
+        if (rc_verbose) {
+            printf("%-5s rANS x%d %8d bytes %5.1f%% %7.1f %7.1f MB/s\n",
+                   name, states, (int)(table + written),
+                   (table + written) * 100.0 / n,
+                   mb_per_s(n, e), mb_per_s(n, d));
+        }
+        // corrupted rANS data is detected or decodes to different data
+        data[table + written / 2] ^= 0x5A;
+        swear(ra_decode(sm, states, data + table, written, out, n) != 0 ||
+              memcmp(in, out, n) != 0);
+    }
+    free(sm);
+    return r;
+}
+
+static int32_t rc_test18(void) {
+    rc_enter("rANS");
+    enum { n = 4 * 1024 * 1024 };
+    const size_t capacity = n * 2 + 1024;
+    uint8_t* in   = allocate(n);
+    uint8_t* out  = allocate(n);
+    uint8_t* data = allocate(capacity);
+    if (rc_verbose) {
+        printf("workload backend       size   ratio  encode  decode\n");
+    }
+    uint64_t bin[2] = { 1, 3 };
+    rc_fill(in, n, bin, countof(bin), countof(bin));
+    int32_t r = rc_rans_vs_range("bin", in, out, n, 2, data, capacity);
+    uint64_t lucas[32] = { 2, 1 };
+    for (size_t i = 2; i < countof(lucas); i++) {
+        lucas[i] = lucas[i - 1] + lucas[i - 2];
+    }
+    if (r == 0) {
+        rc_fill(in, n, lucas, countof(lucas), countof(lucas));
+        r = rc_rans_vs_range("Lucas", in, out, n, 32, data, capacity);
+    }
+    uint64_t zips[256];
+    for (size_t i = 0; i < countof(zips); i++) { zips[i] = i + 1; }
+    if (r == 0) {
+        rc_fill(in, n, zips, countof(zips), countof(zips));
+        r = rc_rans_vs_range("Zipf", in, out, n, 256, data, capacity);
+    }
+    if (r == 0) {
+        memset(in, 0, n);
+        for (size_t i = 1; i < n; i += 1024) { in[i] = 1 + i % 3; }
+        r = rc_rans_vs_range("zeros", in, out, n, 4, data, capacity);
+    }
+    // block container with rANS chunks
+    struct rb_options o = { .chunk = 512 * 1024, .method = rb_method_rans };
+    rc_fill(in, n, zips, countof(zips), countof(zips));
+    if (r == 0) { r = rb_round_trip(in, out, n, &o); }
+    size_t written = 0;
+    if (r == 0) {
+        r = rb_compress(in, n, data, rb_bound(n, &o), &written, &o);
+    }
+    uint8_t methods[n / (512 * 1024)];
+    if (r == 0) { r = rb_methods(data, written, methods, countof(methods)); }
+    for (size_t i = 0; i < countof(methods) && r == 0; i++) {
+        swear(methods[i] == rb_method_rans);
+    }
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return r;
+}
+
+static int32_t rc_lanes_vs_static(const char* name, const uint8_t in[],
+                                  uint8_t out[], size_t n,
+                                  uint8_t* data, size_t capacity) {
+    struct static_model* sm = allocate(sizeof(struct static_model));
+    uint64_t histogram[rc_sym_count] = {0};
+    sm_histogram(histogram, in, n);
+    swear(sm_init(sm, histogram) == 0);
+    // single range coder
+    rc_callbacks(rc, null, null);
+    rc_span(rc, data, capacity);
+    rc_init(rc, 0);
+    uint64_t e = nanoseconds();
+    sm_encode_array(rc, sm, in, n);
+    rc_flush(rc);
+    e = nanoseconds() - e;
+    const size_t bytes = rc->next;
+    swear(rc->error == 0);
+    rc_span(rc, data, bytes);
+    uint64_t d = nanoseconds();
+    rc_init(rc, rc_code(rc));
+    sm_decode_array(rc, sm, out, n);
+    d = nanoseconds() - d;
+    swear(rc->error == 0 && memcmp(in, out, n) == 0);
+    if (rc_verbose) {
+        printf("%-5s static   %8d bytes %5.1f%% %7.1f %7.1f MB/s\n", name,
+               (int)bytes, bytes * 100.0 / n, mb_per_s(n, e), mb_per_s(n, d));
+    }
+    uint8_t* single = allocate(bytes);
+    memcpy(single, data, bytes);
+    int32_t r = 0;
+    for (int32_t lanes = 1; lanes <= ri_max_lanes && r == 0; lanes *= 2) {
+        size_t written = 0;
+        e = nanoseconds();
+        r = ri_encode(sm, lanes, in, n, data, capacity, &written);
+        e = nanoseconds() - e;
+        swear(r == 0);
+        // single lane layout is the layout of a single range coder
+        swear(lanes > 1 || (written == bytes &&
+                            memcmp(data, single, bytes) == 0));
+        memset(out, 0, n);
+        d = nanoseconds();
+        r = ri_decode(sm, lanes, data, written, out, n);
+        d = nanoseconds() - d;
+        swear(r == 0 && memcmp(in, out, n) == 0);
+        if (rc_verbose) {
+            printf("%-5s lanes x%d %8d bytes %5.1f%% %7.1f %7.1f MB/s\n",
+                   name, lanes, (int)written, written * 100.0 / n,
+                   mb_per_s(n, e), mb_per_s(n, d));
+        }
+        // truncated and corrupted streams must be detected
+        swear(ri_decode(sm, lanes, data, written - 1, out, n) != 0);
+        data[written / 2] ^= 0x5A;
+        if (ri_decode(sm, lanes, data, written, out, n) == 0) {
+            swear(memcmp(in, out, n) != 0); // caught by rb checksum
+        }
+    }
+    free(single);
+    free(sm);
+    return r;
+}
+
+static int32_t rc_test19(void) {
+    rc_enter("Interleaved");
+    enum { n = 4 * 1024 * 1024 };
+    const size_t capacity = n * 2 + 1024;
+    uint8_t* in   = allocate(n);
+    uint8_t* out  = allocate(n);
+    uint8_t* data = allocate(capacity);
+    if (rc_verbose) {
+        printf("workload backend       size   ratio  encode  decode\n");
+    }
+    uint64_t bin[2] = { 1, 3 };
+    rc_fill(in, n, bin, countof(bin), countof(bin));
+    int32_t r = rc_lanes_vs_static("bin", in, out, n, data, capacity);
+    uint64_t zips[256];
+    for (size_t i = 0; i < countof(zips); i++) { zips[i] = i + 1; }
+    if (r == 0) {
+        rc_fill(in, n, zips, countof(zips), countof(zips));
+        r = rc_lanes_vs_static("Zipf", in, out, n, data, capacity);
+    }
+    if (r == 0) {
+        memset(in, 0, n);
+        for (size_t i = 1; i < n; i += 1024) { in[i] = 1 + i % 3; }
+        r = rc_lanes_vs_static("zeros", in, out, n, data, capacity);
+    }
+    for (size_t k = 0; k < 64 && r == 0; k++) { // short tails
+        const size_t count = 1 + random64(&seed) % 64;
+        struct static_model sm;
+        uint64_t histogram[rc_sym_count] = {0};
+        sm_histogram(histogram, in + k, count);
+        swear(sm_init(&sm, histogram) == 0);
+        for (int32_t lanes = 1; lanes <= ri_max_lanes; lanes *= 2) {
+            size_t written = 0;
+            swear(ri_encode(&sm, lanes, in + k, count, data, capacity,
+                            &written) == 0);
+            swear(ri_decode(&sm, lanes, data, written, out, count) == 0);
+            swear(memcmp(in + k, out, count) == 0);
+            swear(ri_decode(&sm, lanes, data, written - 1, out, count) != 0);
+        }
+    }
+    // block container with interleaved chunks
+    struct rb_options o = { .chunk = 512 * 1024, .method = rb_method_lanes };
+    rc_fill(in, n, zips, countof(zips), countof(zips));
+    if (r == 0) { r = rb_round_trip(in, out, n, &o); }
+    size_t written = 0;
+    if (r == 0) {
+        r = rb_compress(in, n, data, rb_bound(n, &o), &written, &o);
+    }
+    uint8_t methods[n / (512 * 1024)];
+    if (r == 0) { r = rb_methods(data, written, methods, countof(methods)); }
+    for (size_t i = 0; i < countof(methods) && r == 0; i++) {
+        swear(methods[i] == rb_method_lanes);
+    }
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return r;
+}
+
+static size_t rc_text(uint8_t text[], size_t n) { // random lorem ipsum
+    static const char* words[] = {
+        "lorem", "ipsum", "dolor", "sit", "amet", "consectetur",
+        "adipiscing", "elit", "sed", "do", "eiusmod", "tempor",
+        "incididunt", "ut", "labore", "et", "dolore", "magna", "aliqua",
+        "enim", "ad", "minim", "veniam", "quis", "nostrud", "exercitation",
+        "ullamco", "laboris", "nisi", "aliquip", "ex", "ea", "commodo",
+        "consequat", "duis", "aute", "irure", "in", "reprehenderit"
+    };
+    size_t i = 0;
+    while (i < n) {
+        const char* w = words[random64(&seed) % countof(words)];
+        while (*w != 0 && i < n) { text[i++] = (uint8_t)*w++; }
+        const uint64_t r = random64(&seed) % 16;
+        const char separator = r == 0 ? '.' : (r == 1 ? ',' : ' ');
+        if (i < n) { text[i++] = (uint8_t)separator; }
+        if (separator != ' ' && i < n) { text[i++] = ' '; }
+    }
+    return i;
+}
+
+static void rc_cx_encode(void* that, const void* in, size_t n) {
+    const uint8_t* a = (const uint8_t*)in;
+    for (size_t i = 0; i < n; i++) { cx_encode(rc, that, a[i]); }
+}
+
+static void rc_cx_decode(void* that, void* out, size_t n) {
+    uint8_t* a = (uint8_t*)out;
+    for (size_t i = 0; i < n; i++) { a[i] = cx_decode(rc, that); }
+}
+
+static void rc_cx_reset(void* that) { cx_reset(that); }
+
+static size_t rc_context_round_trip(const uint8_t in[], uint8_t out[],
+                                    size_t n, uint32_t order, uint32_t bits,
+                                    uint8_t* data, size_t capacity) {
+    struct context_model cx;
+    swear(cx_init(&cx, order, bits) == 0);
+    const struct rc_codec c = { &cx, rc_cx_encode, rc_cx_decode,
+                                rc_cx_reset, 1 };
+    const struct rc_trip t = rc_round_trip(&c, in, out, n, data, capacity);
+    char name[64];
+    snprintf(name, sizeof(name), "order-%d bits %2d %6dKB", order, cx.bits,
+             (int)(cx_memory(&cx) / 1024));
+    rc_report(name, &c, n, &t);
+    cx_fini(&cx);
+    return t.bytes;
+}
+
+static int32_t rc_test20(void) {
+    rc_enter("Context");
+    enum { n = 1024 * 1024 };
+    const size_t capacity = n * 2 + 1024;
+    uint8_t* in   = allocate(n);
+    uint8_t* out  = allocate(n);
+    uint8_t* data = allocate(capacity);
+    rc_text(in, n);
+    // order-0 prob_model for reference
+    uint32_t symbols = rc_sym_count;
+    const struct rc_codec reference = rc_pm_codec(&symbols);
+    const struct rc_trip t = rc_round_trip(&reference, in, out, n,
+                                           data, capacity);
+    rc_report("prob_model", &reference, n, &t);
+    const size_t o0 = rc_context_round_trip(in, out, n, 0, 0, data, capacity);
+    const size_t o1 = rc_context_round_trip(in, out, n, 1, 0, data, capacity);
+    const size_t o2 = rc_context_round_trip(in, out, n, 2, 0, data, capacity);
+    const size_t ox = rc_context_round_trip(in, out, n, 2, 16, data, capacity);
+    swear(o1 < o0 && o2 < o1 && ox <= o2);
+    // short input and binary data
+    for (size_t i = 0; i < 4096; i++) { in[i] = (uint8_t)random64(&seed); }
+    rc_context_round_trip(in, out, 4096, 2, 8, data, capacity);
+    struct context_model cx;
+    swear(cx_init(&cx, 3, 0) == rc_err_invalid);
+    swear(cx_init(&cx, 1, 0) == 0);
+    const struct rc_codec c = { &cx, rc_cx_encode, rc_cx_decode,
+                                rc_cx_reset, 1 };
+    rc_corrupted(&c, in, out, 4096, data, capacity);
+    cx_fini(&cx);
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return 0;
+}
+
+struct rc_ppm {
+    struct ppm_model pp;
+    uint32_t restarts; // encoder state to compare with the decoder
+    size_t   used;
+};
+
+static void rc_pp_encode(void* that, const void* in, size_t n) {
+    struct rc_ppm* p = (struct rc_ppm*)that;
+    const uint8_t* a = (const uint8_t*)in;
+    for (size_t i = 0; i < n; i++) { pp_encode(rc, &p->pp, a[i]); }
+}
+
+static void rc_pp_decode(void* that, void* out, size_t n) {
+    struct rc_ppm* p = (struct rc_ppm*)that;
+    uint8_t* a = (uint8_t*)out;
+    for (size_t i = 0; i < n; i++) { a[i] = pp_decode(rc, &p->pp); }
+}
+
+static void rc_pp_reset(void* that) {
+    struct rc_ppm* p = (struct rc_ppm*)that;
+    p->restarts = p->pp.restarts;
+    p->used = p->pp.used;
+    pp_reset(&p->pp);
+    p->pp.restarts = 0;
+}
+
+static size_t rc_ppm_round_trip(const uint8_t in[], uint8_t out[], size_t n,
+                                uint32_t order, uint32_t symbols,
+                                size_t memory, uint8_t* data,
+                                size_t capacity) {
+    struct rc_ppm* p = allocate(sizeof(struct rc_ppm));
+    swear(pp_init(&p->pp, order, symbols, memory) == 0);
+    const struct rc_codec c = { p, rc_pp_encode, rc_pp_decode,
+                                rc_pp_reset, 1 };
+    const struct rc_trip t = rc_round_trip(&c, in, out, n, data, capacity);
+    swear(p->pp.restarts == p->restarts && p->pp.used == p->used);
+    char name[64];
+    snprintf(name, sizeof(name), "order-%d %dKB restarts %d", order,
+             (int)(memory / 1024), p->restarts);
+    rc_report(name, &c, n, &t);
+    pp_fini(&p->pp);
+    free(p);
+    return t.bytes;
+}
+
+static int32_t rc_test21(void) {
+    rc_enter("PPM");
+    enum { n = 1024 * 1024 };
+    const size_t capacity = n * 2 + 1024;
+    uint8_t* in   = allocate(n);
+    uint8_t* out  = allocate(n);
+    uint8_t* data = allocate(capacity);
+    rc_text(in, n);
+    const size_t c2 = rc_context_round_trip(in, out, n, 2, 16,
+                                            data, capacity);
+    enum { mb = 1024 * 1024 };
+    size_t p[5] = {0};
+    for (uint32_t order = 1; order < countof(p); order++) {
+        p[order] = rc_ppm_round_trip(in, out, n, order, 256, 64 * mb,
+                                     data, capacity);
+    }
+    swear(p[2] < c2 && p[3] < p[2]);
+    // small arena restarts the model
+    rc_ppm_round_trip(in, out, n, 4, 256, 64 * 1024, data, capacity);
+    // sparse short input: unseen symbols cost nothing until they appear
+    static const char lorem[] =
+        "Lorem ipsum dolor sit amet, consectetur adipiscing elit, "
+        "sed do eiusmod tempor incididunt ut labore et dolore magna aliqua.";
+    const size_t m = countof(lorem) - 1;
+    uint32_t symbols = rc_sym_count;
+    const struct rc_codec reference = rc_pm_codec(&symbols);
+    const size_t o0 = rc_round_trip(&reference, lorem, out, m,
+                                    data, capacity).bytes;
+    const size_t pb = rc_ppm_round_trip((const uint8_t*)lorem, out, m, 3,
+                                        256, 64 * 1024, data, capacity);
+    swear(pb < o0);
+    // random data over small alphabet
+    for (size_t i = 0; i < n; i++) { in[i] = (uint8_t)(random64(&seed) % 5); }
+    rc_ppm_round_trip(in, out, n, 2, 5, 1 * mb, data, capacity);
+    struct rc_ppm* pp = allocate(sizeof(struct rc_ppm));
+    swear(pp_init(&pp->pp, 0, 256, mb) == rc_err_invalid);
+    swear(pp_init(&pp->pp, 3, 256, mb) == 0);
+    const struct rc_codec c = { pp, rc_pp_encode, rc_pp_decode,
+                                rc_pp_reset, 1 };
+    rc_text(in, 4096);
+    rc_corrupted(&c, in, out, 4096, data, capacity);
+    pp_fini(&pp->pp);
+    // symbol outside of the alphabet is rejected and not coded
+    swear(pp_init(&pp->pp, 2, 5, mb) == 0);
+    const size_t used = pp->pp.used;
+    rc_span(rc, data, capacity);
+    rc_init(rc, 0);
+    pp_encode(rc, &pp->pp, 5);
+    swear(rc->error == rc_err_invalid && pp->pp.used == used);
+    rc->error = 0;
+    pp_fini(&pp->pp);
+    free(pp);
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return 0;
+}
+
+static void rc_mx_encode(void* that, const void* in, size_t n) {
+    const uint8_t* a = (const uint8_t*)in;
+    for (size_t i = 0; i < n; i++) { mx_encode(rc, that, a[i]); }
+}
+
+static void rc_mx_decode(void* that, void* out, size_t n) {
+    uint8_t* a = (uint8_t*)out;
+    for (size_t i = 0; i < n; i++) { a[i] = mx_decode(rc, that); }
+}
+
+static void rc_mx_reset(void* that) { mx_model_reset(that); }
+
+static size_t rc_mix_round_trip(const uint8_t in[], uint8_t out[], size_t n,
+                                uint8_t* data, size_t capacity) {
+    struct mix_model* mm = allocate(sizeof(struct mix_model));
+    swear(mx_model_init(mm, 0) == 0);
+    const struct rc_codec c = { mm, rc_mx_encode, rc_mx_decode,
+                                rc_mx_reset, 1 };
+    const struct rc_trip t = rc_round_trip(&c, in, out, n, data, capacity);
+    rc_report("mixing", &c, n, &t);
+    mx_model_fini(mm);
+    free(mm);
+    return t.bytes;
+}
+
+static int32_t rc_test22(void) {
+    rc_enter("Mixing");
+    struct mixer* mx = allocate(sizeof(struct mixer));
+    mx_init(mx, 2, mx_default_rate);
+    for (uint32_t p = 1; p < bc_prob_one; p++) { // stretch() ~ squash^-1
+        const int32_t d = (int32_t)mx_squash(mx_stretch(p)) - (int32_t)p;
+        swear(-64 < d && d < 64);
+    }
+    // mixer learns to trust the right input
+    for (int32_t i = 0; i < 10000; i++) {
+        const bool bit = random64(&seed) % 8 == 0; // p(0) = 7/8
+        mx_add(mx, bc_prob_one * 7 / 8);
+        mx_add(mx, bc_prob_one / 8);
+        mx_mix(mx, 0);
+        mx_update(mx, bit);
+    }
+    mx_add(mx, bc_prob_one * 7 / 8);
+    mx_add(mx, bc_prob_one / 8);
+    const uint32_t p = mx_mix(mx, 0);
+    swear(p > bc_prob_one * 3 / 4);
+    free(mx);
+    enum { n = 1024 * 1024 };
+    const size_t capacity = n * 2 + 1024;
+    uint8_t* in   = allocate(n);
+    uint8_t* out  = allocate(n);
+    uint8_t* data = allocate(capacity);
+    rc_text(in, n);
+    const size_t c2 = rc_context_round_trip(in, out, n, 2, 0, data, capacity);
+    rc_ppm_round_trip(in, out, n, 3, 256, 64 * 1024 * 1024, data, capacity);
+    const size_t mb = rc_mix_round_trip(in, out, n, data, capacity);
+    swear(mb < c2);
+    for (size_t i = 0; i < n; i++) { in[i] = (uint8_t)random64(&seed); }
+    rc_mix_round_trip(in, out, 64 * 1024, data, capacity);
+    struct mix_model* mm = allocate(sizeof(struct mix_model));
+    swear(mx_model_init(mm, 8) == rc_err_invalid);
+    swear(mx_model_init(mm, 16) == 0);
+    const struct rc_codec c = { mm, rc_mx_encode, rc_mx_decode,
+                                rc_mx_reset, 1 };
+    rc_text(in, 4096);
+    rc_corrupted(&c, in, out, 4096, data, capacity);
+    mx_model_fini(mm);
+    free(mm);
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return 0;
+}
+
+static void rc_log(uint8_t a[], size_t n) {
+    // log like lines: few templates with random fields
+    static const char* level[] = { "INFO", "INFO", "INFO", "WARN", "ERROR" };
+    static const char* path[]  = {
+        "/api/v1/items", "/api/v1/users", "/api/v1/orders", "/health"
+    };
+    size_t i = 0;
+    uint32_t t = 0;
+    while (i < n) {
+        char line[256];
+        t += (uint32_t)(random64(&seed) % 3);
+        const uint64_t r = random64(&seed);
+        const int k = snprintf(line, sizeof(line),
+            "2024-10-16 %02u:%02u:%02u %s request id=%06u "
+            "path=%s status=%u\n",
+            (t / 3600) % 24, (t / 60) % 60, t % 60,
+            level[r % countof(level)], (uint32_t)(r >> 8) % 1000000,
+            path[(r >> 32) % countof(path)],
+            (r >> 40) % 16 == 0 ? 404 : 200);
+        for (int j = 0; j < k && i < n; j++) { a[i++] = (uint8_t)line[j]; }
+    }
+}
+
+static int32_t rc_test23(void) {
+    rc_enter("Match");
+    struct match_model* ma = allocate(sizeof(struct match_model));
+    swear(ma_init(ma, 8, 0) == rc_err_invalid);
+    swear(ma_init(ma, 0, 40) == rc_err_invalid);
+    swear(ma_init(ma, 16, 10) == 0);
+    // periodic pattern is predicted after the first period
+    for (uint32_t i = 0; i < 255 + ma_min_length; i++) {
+        ma_update(ma, (uint8_t)(i % 255));
+    }
+    for (uint32_t i = 255 + ma_min_length; i < 128 * 1024; i++) {
+        swear(ma_predicted(ma) == (int32_t)(i % 255));
+        ma_update(ma, (uint8_t)(i % 255));
+    }
+    swear(ma->length == ma_max_length);
+    ma_update(ma, 0xFF); // mismatch ends the match
+    swear(ma_predicted(ma) == -1);
+    ma_fini(ma);
+    free(ma);
+    enum { n = 1024 * 1024 };
+    const size_t capacity = n * 2 + 1024;
+    uint8_t* in   = allocate(n);
+    uint8_t* out  = allocate(n);
+    uint8_t* data = allocate(capacity);
+    // rc_test1() periodic pattern: order-0 cannot exploit it
+    for (size_t i = 0; i < n; i++) { in[i] = (uint8_t)(i % 255); }
+    rc_context_round_trip(in, out, n, 0, 0, data, capacity);
+    size_t mb = rc_mix_round_trip(in, out, n, data, capacity);
+    swear(mb * 8 < n / 20); // < 0.05 bit per byte
+    // long repeats of text cost a fraction of a bit per byte
+    enum { m = 64 * 1024 };
+    rc_text(in, m);
+    const size_t once = rc_mix_round_trip(in, out, m, data, capacity);
+    for (size_t i = m; i < m * 8; i++) { in[i] = in[i - m]; }
+    mb = rc_mix_round_trip(in, out, m * 8, data, capacity);
+    swear((mb - once) * 8 < m * 7 / 10); // repeats < 0.1 bit per byte
+    rc_log(in, n);
+    rc_context_round_trip(in, out, n, 2, 0, data, capacity);
+    rc_ppm_round_trip(in, out, n, 3, 256, 64 * 1024 * 1024, data, capacity);
+    rc_mix_round_trip(in, out, n, data, capacity);
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return 0;
+}
+
+static void rc_lz_encode(void* that, const void* in, size_t n) {
+    swear(lz_encode(rc, that, (const uint8_t*)in, n) == 0);
+}
+
+static void rc_lz_decode(void* that, void* out, size_t n) {
+    (void)lz_decode(rc, that, (uint8_t*)out, n); // returns rc->error
+}
+
+static size_t rc_lz_round_trip(const uint8_t in[], uint8_t out[], size_t n,
+                               int32_t level, uint8_t* data,
+                               size_t capacity) {
+    struct lz_model* lz = allocate(sizeof(struct lz_model));
+    swear(lz_init(lz, level, 0) == 0);
+    const struct rc_codec c = { lz, rc_lz_encode, rc_lz_decode, null, 1 };
+    const struct rc_trip t = rc_round_trip(&c, in, out, n, data, capacity);
+    char name[64];
+    snprintf(name, sizeof(name), "lz level %d", level);
+    rc_report(name, &c, n, &t);
+    lz_fini(lz);
+    free(lz);
+    return t.bytes;
+}
+
+static int32_t rc_test24(void) {
+    rc_enter("LZ77");
+    enum { n = 1024 * 1024 };
+    const size_t capacity = n * 2 + 1024;
+    uint8_t* in   = allocate(n);
+    uint8_t* out  = allocate(n);
+    uint8_t* data = allocate(capacity);
+    struct lz_model* lz = allocate(sizeof(struct lz_model));
+    swear(lz_init(lz, 10, 0) == rc_err_invalid);
+    swear(lz_init(lz, 1, 25) == rc_err_invalid);
+    free(lz);
+    // tiny inputs: no room for a match
+    for (size_t i = 0; i < 8; i++) { in[i] = (uint8_t)i; }
+    for (size_t k = 0; k <= 8; k++) {
+        rc_lz_round_trip(in, out, k, 1, data, capacity);
+    }
+    // rc_test1() periodic pattern and runs
+    for (size_t i = 0; i < n; i++) { in[i] = (uint8_t)(i % 255); }
+    swear(rc_lz_round_trip(in, out, n, 1, data, capacity) < n / 100);
+    memset(in, 0, n);
+    swear(rc_lz_round_trip(in, out, n, 9, data, capacity) < n / 100);
+    // levels trade speed for ratio
+    rc_log(in, n);
+    const size_t order0 = rc_context_round_trip(in, out, n, 0, 0,
+                                                data, capacity);
+    const size_t fast = rc_lz_round_trip(in, out, n, 1, data, capacity);
+    rc_lz_round_trip(in, out, n, 6, data, capacity);
+    const size_t best = rc_lz_round_trip(in, out, n, 9, data, capacity);
+    swear(best <= fast && fast < order0);
+    rc_text(in, n / 4);
+    rc_lz_round_trip(in, out, n / 4, 1, data, capacity);
+    rc_lz_round_trip(in, out, n / 4, 9, data, capacity);
+    // incompressible data
+    for (size_t i = 0; i < n; i++) { in[i] = (uint8_t)random64(&seed); }
+    swear(rc_lz_round_trip(in, out, 64 * 1024, 6, data, capacity) <
+          64 * 1024 + 64 * 1024 / 8);
+    rc_log(in, 4096);
+    lz = allocate(sizeof(struct lz_model));
+    swear(lz_init(lz, 6, 16) == 0);
+    const struct rc_codec c = { lz, rc_lz_encode, rc_lz_decode, null, 1 };
+    rc_corrupted(&c, in, out, 4096, data, capacity);
+    lz_fini(lz);
+    free(lz);
+    // block container with LZ chunks
+    int32_t r = 0;
+    struct rb_options o = { .chunk = 256 * 1024, .method = rb_method_lz,
+                            .level = 9 };
+    rc_log(in, n);
+    if (r == 0) { r = rb_round_trip(in, out, n, &o); }
+    o.level = 10;
+    size_t bytes = 0;
+    swear(rb_compress(in, n, data, capacity, &bytes, &o) == rc_err_invalid);
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return r;
+}
+
+static int32_t rc_test25(void) {
+    rc_enter("Prices");
+    for (uint32_t k = 0; k < 64; k++) {
+        swear(rc_log2_price(1uLL << k) == k << rc_price_bits);
+    }
+    struct prob_model* m = allocate(sizeof(struct prob_model));
+    struct price_table* pt = allocate(sizeof(struct price_table));
+    pm_init(m, 200);
+    for (size_t i = 0; i < 64 * 1024; i++) {
+        const uint64_t r = random64(&seed);
+        pm_update(m, (uint8_t)((r % 200) * ((r >> 32) % 200) / 200), 1);
+    }
+    pm_prices(m, pt);
+    const double total = (double)m->tree[rc_sym_count - 1];
+    for (uint32_t i = 0; i < rc_sym_count; i++) {
+        swear(pt->cost[i] == pm_cost(m, (uint8_t)i));
+        if (m->freq[i] == 0) {
+            swear(pt->cost[i] == rc_price_max);
+        } else {
+            const double bits = -log2(m->freq[i] / total);
+            const double d = pt->cost[i] - bits * (1 << rc_price_bits);
+            swear(-2 < d && d < 2); // within 1/8 bit
+        }
+    }
+    enum { queries = 16 * 1024 * 1024 };
+    uint64_t sum = 0;
+    uint64_t t = nanoseconds();
+    for (uint32_t i = 0; i < queries; i++) {
+        sum += pm_cost(m, (uint8_t)(i * 0x9E3779B1u >> 24));
+    }
+    t = nanoseconds() - t;
+    if (rc_verbose) {
+        printf("pm_cost() %.2f ns per query (%llu)\n",
+               (double)t / queries, sum);
+    }
+    free(pt);
+    free(m);
+    // optimal parse vs lazy matching
+    enum { n = 1024 * 1024 };
+    const size_t capacity = n * 2 + 1024;
+    uint8_t* in   = allocate(n);
+    uint8_t* out  = allocate(n);
+    uint8_t* data = allocate(capacity);
+    rc_log(in, n);
+    size_t lazy = rc_lz_round_trip(in, out, n, 7, data, capacity);
+    rc_lz_round_trip(in, out, n, 8, data, capacity);
+    size_t best = rc_lz_round_trip(in, out, n, 9, data, capacity);
+    swear(best < lazy);
+    rc_text(in, n / 4);
+    lazy = rc_lz_round_trip(in, out, n / 4, 7, data, capacity);
+    best = rc_lz_round_trip(in, out, n / 4, 9, data, capacity);
+    swear(best < lazy);
+    for (size_t i = 0; i < n; i++) { in[i] = (uint8_t)(i % 255); }
+    swear(rc_lz_round_trip(in, out, n, 9, data, capacity) < n / 100);
+    for (size_t i = 0; i < n; i++) { in[i] = (uint8_t)random64(&seed); }
+    rc_lz_round_trip(in, out, 64 * 1024, 8, data, capacity);
+    for (size_t k = 0; k <= 8; k++) {
+        rc_lz_round_trip(in, out, k, 9, data, capacity);
+    }
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return 0;
+}
+
+static void rc_ic_encode(void* that, const void* in, size_t n) {
+    const uint64_t* a = (const uint64_t*)in;
+    for (size_t i = 0; i < n; i++) { ic_encode(rc, that, a[i]); }
+}
+
+static void rc_ic_decode(void* that, void* out, size_t n) {
+    uint64_t* a = (uint64_t*)out;
+    for (size_t i = 0; i < n; i++) { a[i] = ic_decode(rc, that); }
+}
+
+static void rc_ic_reset(void* that) { ic_reset(that); }
+
+static size_t rc_int_round_trip(const uint64_t in[], uint64_t out[], size_t n,
+                                uint32_t transform, uint8_t* data,
+                                size_t capacity) {
+    static const char* names[] = { "raw", "zigzag", "delta", "delta2" };
+    struct int_model* im = allocate(sizeof(struct int_model));
+    swear(ic_init(im, transform) == 0);
+    const struct rc_codec c = { im, rc_ic_encode, rc_ic_decode,
+                                rc_ic_reset, sizeof(in[0]) };
+    const struct rc_trip t = rc_round_trip(&c, in, out, n, data, capacity);
+    char name[64];
+    snprintf(name, sizeof(name), "ic %s", names[transform]);
+    rc_report(name, &c, n, &t);
+    free(im);
+    return t.bytes;
+}
+
+static size_t rc_planes(const uint64_t in[], size_t n, uint32_t planes,
+                        uint8_t* data, size_t capacity) {
+    // byte plane coding of rc_test6(): one prob_model per byte
+    struct prob_model* m = allocate(sizeof(struct prob_model) * planes);
+    for (uint32_t j = 0; j < planes; j++) { pm_init(&m[j], rc_sym_count); }
+    rc_callbacks(rc, null, null);
+    rc_span(rc, data, capacity);
+    rc_init(rc, 0);
+    for (size_t i = 0; i < n; i++) {
+        for (uint32_t j = 0; j < planes; j++) {
+            rc_encode(rc, &m[j], (uint8_t)(in[i] >> (j * 8)));
+        }
+    }
+    rc_flush(rc);
+    const size_t bytes = rc->next;
+    if (rc_verbose) {
+        printf("%d byte planes %8d bytes %6.3f bits per value\n",
+               planes, (int)bytes, bytes * 8.0 / n);
+    }
+    free(m);
+    return bytes;
+}
+
+static int32_t rc_test26(void) {
+    rc_enter("Integers");
+    struct int_model* im = allocate(sizeof(struct int_model));
+    swear(ic_init(im, ic_delta2 + 1) == rc_err_invalid);
+    free(im);
+    enum { n = 64 * 1024 };
+    const size_t capacity = n * 16 + 1024;
+    uint64_t* in  = allocate(n * sizeof(uint64_t));
+    uint64_t* out = allocate(n * sizeof(uint64_t));
+    uint8_t* data = allocate(capacity);
+    // rc_test6() Zipf's sizes and distances
+    for (size_t i = 0; i < n; i++) {
+        const double z = 1.0 / (n - i);
+        in[i] = (uint16_t)(z * rand64(&seed) * ((double)UINT16_MAX + 1));
+    }
+    shuffle(in, n);
+    swear(rc_int_round_trip(in, out, n, ic_raw, data, capacity) <=
+          rc_planes(in, n, 2, data, capacity));
+    for (size_t i = 0; i < n; i++) {
+        const double z = 1.0 / (n - i);
+        in[i] = (uint32_t)(z * rand64(&seed) * ((double)UINT32_MAX + 1));
+    }
+    shuffle(in, n);
+    swear(rc_int_round_trip(in, out, n, ic_raw, data, capacity) <
+          rc_planes(in, n, 4, data, capacity));
+    // timestamps in milliseconds with small jitter
+    uint64_t t = 1729000000000uLL;
+    for (size_t i = 0; i < n; i++) {
+        t += 1000 + random64(&seed) % 7 - 3;
+        in[i] = t;
+    }
+    const size_t raw = rc_int_round_trip(in, out, n, ic_raw, data, capacity);
+    const size_t d1 = rc_int_round_trip(in, out, n, ic_delta, data, capacity);
+    const size_t d2 = rc_int_round_trip(in, out, n, ic_delta2, data,
+                                        capacity);
+    swear(d2 < d1 && d1 < raw);
+    rc_planes(in, n, 8, data, capacity);
+    // signed random walk gauge
+    int64_t g = 0;
+    for (size_t i = 0; i < n; i++) {
+        g += (int64_t)(random64(&seed) % 201) - 100;
+        in[i] = (uint64_t)g;
+    }
+    const size_t zz = rc_int_round_trip(in, out, n, ic_zigzag, data,
+                                        capacity);
+    swear(rc_int_round_trip(in, out, n, ic_delta, data, capacity) < zz);
+    // extremes wrap around modulo 2^64 in all transforms
+    const uint64_t extremes[] = { 0, 1, UINT64_MAX, (uint64_t)INT64_MIN,
+                                  (uint64_t)INT64_MAX, 0, UINT64_MAX, 1 };
+    for (uint32_t k = ic_raw; k <= ic_delta2; k++) {
+        rc_int_round_trip(extremes, out, countof(extremes), k, data,
+                          capacity);
+    }
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return 0;
+}
+
+static int32_t rc_test27(void) {
+    rc_enter("Bypass");
+    enum { n = 256 * 1024 };
+    const size_t capacity = n * 8 + 1024;
+    uint32_t* in   = allocate(n * sizeof(uint32_t));
+    uint32_t* out  = allocate(n * sizeof(uint32_t));
+    uint8_t*  bits = allocate(n);
+    uint8_t*  data = allocate(capacity);
+    uint8_t*  copy = allocate(capacity);
+    for (size_t i = 0; i < n; i++) {
+        bits[i] = (uint8_t)(random64(&seed) % 33);
+        in[i] = bits[i] == 0 ? 0 : (uint32_t)(random64(&seed) >>
+                                              (64 - bits[i]));
+    }
+    // bit identical to rc_encode_range() with power of 2 total
+    rc_callbacks(rc, null, null);
+    rc_span(rc, data, capacity);
+    rc_init(rc, 0);
+    for (size_t i = 0; i < n; i++) { rc_encode_bits(rc, in[i], bits[i]); }
+    rc_flush(rc);
+    const size_t bytes = rc->next;
+    rc_span(rc, copy, capacity);
+    rc_init(rc, 0);
+    for (size_t i = 0; i < n; i++) {
+        if (bits[i] > 0) { rc_encode_range(rc, in[i], 1, 1uLL << bits[i]); }
+    }
+    rc_flush(rc);
+    swear(rc->error == 0 && rc->next == bytes &&
+          memcmp(data, copy, bytes) == 0);
+    // mixed with modeled symbols in the same stream
+    pm_init(pm, rc_sym_count);
+    rc_span(rc, data, capacity);
+    rc_init(rc, 0);
+    for (size_t i = 0; i < n; i++) {
+        rc_encode(rc, pm, bits[i]);
+        rc_encode_bits(rc, in[i], bits[i]);
+    }
+    rc_flush(rc);
+    swear(rc->error == 0);
+    size_t written = rc->next;
+    pm_init(pm, rc_sym_count);
+    rc_span(rc, data, written);
+    rc_init(rc, rc_code(rc));
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t k = rc_decode(rc, pm);
+        out[i] = rc_decode_bits(rc, k);
+        swear(k == bits[i]);
+    }
+    swear(rc->error == 0 && memcmp(in, out, n * sizeof(uint32_t)) == 0);
+    // uniform 32 bit fields: byte planes (see rc_test6()) vs bypass
+    for (size_t i = 0; i < n; i++) { in[i] = (uint32_t)random64(&seed); }
+    struct prob_model* planes = allocate(sizeof(struct prob_model) * 4);
+    for (int32_t j = 0; j < 4; j++) { pm_init(&planes[j], rc_sym_count); }
+    rc_span(rc, data, capacity);
+    rc_init(rc, 0);
+    uint64_t tp = nanoseconds();
+    for (size_t i = 0; i < n; i++) {
+        for (int32_t j = 0; j < 4; j++) {
+            rc_encode(rc, &planes[j], (uint8_t)(in[i] >> (j * 8)));
+        }
+    }
+    rc_flush(rc);
+    tp = nanoseconds() - tp;
+    const size_t bp = rc->next;
+    rc_span(rc, data, capacity);
+    rc_init(rc, 0);
+    uint64_t te = nanoseconds();
+    for (size_t i = 0; i < n; i++) { rc_encode_bits(rc, in[i], 32); }
+    rc_flush(rc);
+    te = nanoseconds() - te;
+    written = rc->next;
+    swear(written <= n * 4 + 16 && written <= bp);
+    rc_span(rc, data, written);
+    uint64_t td = nanoseconds();
+    rc_init(rc, rc_code(rc));
+    for (size_t i = 0; i < n; i++) { out[i] = rc_decode_bits(rc, 32); }
+    td = nanoseconds() - td;
+    swear(rc->error == 0 && memcmp(in, out, n * sizeof(uint32_t)) == 0);
+    if (rc_verbose) {
+        printf("byte planes %d bytes %.1f MB/s bypass %d bytes "
+               "%.1f %.1f MB/s\n", (int)bp, mb_per_s(n * 4, tp),
+               (int)written, mb_per_s(n * 4, te), mb_per_s(n * 4, td));
+    }
+    free(planes);
+    // corrupted input is detected or decodes to different data
+    data[written / 2] ^= 0x5A;
+    rc_span(rc, data, written);
+    rc_init(rc, rc_code(rc));
+    for (size_t i = 0; i < n; i++) { out[i] = rc_decode_bits(rc, 32); }
+    swear(rc->error != 0 || memcmp(in, out, n * sizeof(uint32_t)) != 0);
+    free(copy);
+    free(data);
+    free(bits);
+    free(out);
+    free(in);
+    rc_exit();
+    return 0;
+}
+
+static int32_t rc_test28(void) {
+    rc_enter("Stored");
+    enum { n = 1024 * 1024, chunk = 256 * 1024, chunks = n / chunk };
+    uint8_t* in  = allocate(n);
+    uint8_t* out = allocate(n);
+    for (size_t i = 0; i < n; i++) { in[i] = (uint8_t)random64(&seed); }
+    uint8_t methods[chunks];
+    const uint8_t requested[] = {
+        rb_method_range, rb_method_rans, rb_method_lanes, rb_method_lz
+    };
+    int32_t r = 0;
+    for (size_t k = 0; k < countof(requested) && r == 0; k++) {
+        struct rb_options o = { .chunk = chunk, .method = requested[k] };
+        const size_t bound = rb_bound(n, &o);
+        uint8_t* data = allocate(bound);
+        size_t written = 0;
+        uint64_t t0 = nanoseconds();
+        r = rb_compress(in, n, data, bound, &written, &o);
+        uint64_t t1 = nanoseconds();
+        swear(r == 0);
+        // framing only: header, chunk headers, end, index and footer
+        swear(written == n + rb_header_size + rb_chunk_header +
+                         chunks * (rb_chunk_header + rb_index_entry) +
+                         rb_footer_size);
+        swear(rb_methods(data, written, methods, chunks) == 0);
+        for (uint32_t i = 0; i < chunks; i++) {
+            swear(methods[i] == rb_method_stored);
+        }
+        size_t bytes = 0;
+        r = rb_decompress(data, written, out, n, &bytes, &o);
+        uint64_t t2 = nanoseconds();
+        swear(r == 0 && bytes == n && memcmp(in, out, n) == 0);
+        if (rc_verbose) {
+            printf("method %d stored compress: %.1f MB/s "
+                   "decompress: %.1f MB/s\n", requested[k],
+                   mb_per_s(n, t1 - t0), mb_per_s(n, t2 - t1));
+        }
+        r = rb_read(data, written, n / 3, out, n / 3);
+        swear(r == 0 && memcmp(in + n / 3, out, n / 3) == 0);
+        r = rb_stream_round_trip(data, written, out, n, &bytes, 10000);
+        swear(r == 0 && bytes == n && memcmp(in, out, n) == 0);
+        // corrupted stored chunk is caught by the checksum
+        data[rb_header_size + rb_chunk_header + chunk / 2] ^= 0x5A;
+        swear(rb_decompress(data, written, out, n, &bytes, &o) ==
+              rc_err_data);
+        free(data);
+    }
+    // compressible chunks are coded, incompressible ones are stored
+    rc_text(in, n / 2);
+    struct rb_options o = { .chunk = chunk };
+    const size_t bound = rb_bound(n, &o);
+    uint8_t* data = allocate(bound);
+    size_t written = 0;
+    r = rb_compress(in, n, data, bound, &written, &o);
+    swear(r == 0);
+    swear(rb_methods(data, written, methods, chunks) == 0);
+    swear(methods[0] == rb_method_range && methods[1] == rb_method_range &&
+          methods[2] == rb_method_stored && methods[3] == rb_method_stored);
+    if (r == 0) { r = rb_round_trip(in, out, n, &o); }
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return r;
+}
+
+static int32_t rc_test29(void) {
+    rc_enter("Histogram");
+    enum { n = 1024 * 1024 + 13 }; // not multiple of 8 bytes
+    uint8_t* in = allocate(n);
+    static uint64_t histogram[rc_sym_count];
+    static uint64_t expected[rc_sym_count];
+    for (int32_t kind = 0; kind < 4; kind++) {
+        static const char* name[] = { "random", "zeros", "text", "sparse" };
+        for (size_t i = 0; i < n; i++) {
+            in[i] = kind == 0 ? (uint8_t)random64(&seed) :
+                    kind == 3 && random64(&seed) % 64 == 0 ?
+                    (uint8_t)random64(&seed) : 0;
+        }
+        if (kind == 2) { rc_text(in, n); }
+        memset(expected, 0, sizeof(expected));
+        for (size_t i = 0; i < n; i++) { expected[in[i]]++; }
+        const size_t offset = 3; // unaligned
+        for (size_t i = offset; i < n; i++) { expected[in[i]]--; }
+        memset(histogram, 0, sizeof(histogram));
+        sm_histogram(histogram, in, offset);
+        sm_histogram(histogram, in, n); // adds to histogram[]
+        for (size_t i = 0; i < n; i++) { expected[in[i]]++; }
+        swear(memcmp(histogram, expected, sizeof(histogram)) == 0);
+        memset(histogram, 0, sizeof(histogram));
+        enum { repeat = 64 };
+        uint64_t t0 = nanoseconds();
+        for (int32_t r = 0; r < repeat; r++) {
+            memset(histogram, 0, sizeof(histogram));
+            sm_histogram(histogram, in, n);
+        }
+        uint64_t t1 = nanoseconds();
+        const uint64_t price = sm_entropy(histogram);
+        double exact = 0; // reference with floating point log2()
+        for (size_t i = 0; i < rc_sym_count; i++) {
+            if (histogram[i] > 0) {
+                exact -= histogram[i] * log2((double)histogram[i] / n);
+            }
+        }
+        const double bps = price / (double)(1u << rc_price_bits) / n;
+        swear(fabs(bps - exact / n) < 1.0 / 16);
+        if (rc_verbose) {
+            printf("%-6s entropy: %.4f estimate: %.4f bps "
+                   "histogram: %.1f MB/s\n", name[kind], exact / n, bps,
+                   mb_per_s((size_t)n * repeat, t1 - t0));
+        }
+    }
+    free(in);
+    rc_exit();
+    return 0;
+}
+
+struct rc_runs {
+    struct run_model rl;
+    uint32_t symbols;
+    size_t   split; // in[0..split) and in[split..n) are coded in two calls
+};
+
+static void rc_rl_encode(void* that, const void* in, size_t n) {
+    struct rc_runs* r = (struct rc_runs*)that;
+    const uint8_t* a = (const uint8_t*)in;
+    rl_encode_array(rc, &r->rl, a, r->split);
+    rl_encode_array(rc, &r->rl, a + r->split, n - r->split);
+}
+
+static void rc_rl_decode(void* that, void* out, size_t n) {
+    struct rc_runs* r = (struct rc_runs*)that;
+    uint8_t* a = (uint8_t*)out;
+    const size_t k = rl_decode_array(rc, &r->rl, a, r->split);
+    if (k == r->split) {
+        rl_decode_array(rc, &r->rl, a + r->split, n - r->split);
+    }
+}
+
+static void rc_rl_reset(void* that) {
+    struct rc_runs* r = (struct rc_runs*)that;
+    rl_init(&r->rl, r->symbols);
+}
+
+static size_t rc_run_round_trip(const uint8_t in[], uint8_t out[], size_t n,
+                                uint32_t symbols, size_t split,
+                                uint8_t data[], size_t capacity) {
+    struct rc_runs* r = allocate(sizeof(struct rc_runs));
+    rl_init(&r->rl, symbols);
+    r->symbols = symbols;
+    r->split = split;
+    const struct rc_codec c = { r, rc_rl_encode, rc_rl_decode,
+                                rc_rl_reset, 1 };
+    const struct rc_trip t = rc_round_trip(&c, in, out, n, data, capacity);
+    char name[64];
+    snprintf(name, sizeof(name), "run split %d", (int)split);
+    rc_report(name, &c, n, &t);
+    free(r);
+    return t.bytes;
+}
+
+struct rc_compact {
+    struct compact_model cm;
+    uint32_t symbols;
+};
+
+static void rc_cm_encode(void* that, const void* in, size_t n) {
+    struct rc_compact* m = (struct rc_compact*)that;
+    const uint8_t* a = (const uint8_t*)in;
+    for (size_t i = 0; i < n; i++) { cm_encode(rc, &m->cm, a[i]); }
+}
+
+static void rc_cm_decode(void* that, void* out, size_t n) {
+    struct rc_compact* m = (struct rc_compact*)that;
+    uint8_t* a = (uint8_t*)out;
+    for (size_t i = 0; i < n; i++) { a[i] = cm_decode(rc, &m->cm); }
+}
+
+static void rc_cm_reset(void* that) {
+    struct rc_compact* m = (struct rc_compact*)that;
+    cm_init(&m->cm, m->symbols);
+}
+
+static size_t rc_compact_round_trip(const uint8_t in[], uint8_t out[],
+                                    size_t n, uint32_t symbols,
+                                    uint8_t data[], size_t capacity) {
+    // symbol by symbol cm_encode() for comparison
+    struct rc_compact* m = allocate(sizeof(struct rc_compact));
+    m->symbols = symbols;
+    rc_cm_reset(m);
+    const struct rc_codec c = { m, rc_cm_encode, rc_cm_decode,
+                                rc_cm_reset, 1 };
+    const struct rc_trip t = rc_round_trip(&c, in, out, n, data, capacity);
+    rc_report("compact", &c, n, &t);
+    free(m);
+    return t.bytes;
+}
+
+static int32_t rc_test30(void) {
+    rc_enter("Runs");
+    enum { n = 1024 * 1024, record = 64 };
+    const size_t capacity = n * 2 + 1024;
+    uint8_t* in   = allocate(n);
+    uint8_t* out  = allocate(n);
+    uint8_t* data = allocate(capacity);
+    for (int32_t kind = 0; kind < 4; kind++) {
+        static const char* name[] = {
+            "zeros", "bitmap", "records", "random"
+        };
+        uint32_t symbols = rc_sym_count;
+        if (kind == 0) { // rc_test5() "Long zeros"
+            symbols = 4;
+            memset(in, 0, n);
+            for (size_t i = 1; i < n; i += 1024) {
+                in[i] = (uint8_t)(rand64(&seed) * (symbols - 1));
+            }
+        } else if (kind == 1) { // sparse bitmap: ~1/256 of bits set
+            memset(in, 0, n);
+            for (size_t i = 0; i < n * 8 / 256; i++) {
+                const uint64_t bit = random64(&seed) % (n * 8);
+                in[bit / 8] |= (uint8_t)(1u << (bit % 8));
+            }
+        } else if (kind == 2) { // zero padded records
+            memset(in, 0, n);
+            rc_text(out, n);
+            for (size_t i = 0; i < n; i += record) {
+                memcpy(in + i, out + i, 8 + random64(&seed) % 32);
+            }
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                in[i] = (uint8_t)random64(&seed);
+            }
+        }
+        if (rc_verbose) { printf("%s:\n", name[kind]); }
+        const size_t bytes = rc_run_round_trip(in, out, n, symbols, 0,
+                                               data, capacity);
+        const size_t compact = rc_compact_round_trip(in, out, n, symbols,
+                                                     data, capacity);
+        if (kind < 3) {
+            swear(bytes < compact);
+        } else { // no runs: rare short runs cost little
+            swear(bytes <= compact + compact / 256);
+        }
+        // runs cut at the end of array and continued by the next call
+        swear(rc_run_round_trip(in, out, n, symbols, n / 3,
+                                data, capacity) > 0);
+    }
+    // binary alphabet: the symbol that ends a run is implied
+    for (size_t i = 0; i < n; i++) {
+        in[i] = (uint8_t)(random64(&seed) % 64 == 0);
+    }
+    rc_run_round_trip(in, out, n, 2, n / 3, data, capacity);
+    // corrupted stream is detected or decodes to different data
+    memset(in, 0, n);
+    for (size_t i = 1; i < n; i += 1024) { in[i] = (uint8_t)(1 + i % 3); }
+    struct rc_runs* r = allocate(sizeof(struct rc_runs));
+    rl_init(&r->rl, 4);
+    r->symbols = 4;
+    r->split = n / 2;
+    const struct rc_codec c = { r, rc_rl_encode, rc_rl_decode,
+                                rc_rl_reset, 1 };
+    rc_corrupted(&c, in, out, n, data, capacity);
+    free(r);
+    free(data);
+    free(out);
+    free(in);
+    rc_exit();
+    return 0;
+}
+
 static int32_t rc_tests(int iterations, bool verbose, bool randomize) {
     swear(iterations > 0);
     if (randomize) { seed = nanoseconds() | 1; }
@@ -592,7 +2588,15 @@ static int32_t rc_tests(int iterations, bool verbose, bool randomize) {
     for (int i = 0; i < iterations && r == 0; i++) {
         r = rc_test0() || rc_test1() || rc_test2() ||
             rc_test3() || rc_test4() || rc_test5() ||
-            rc_test6() || rc_test7() || rc_test8();
+            rc_test6() || rc_test7() || rc_test8() ||
+            rc_test9() || rc_test10() || rc_test11() ||
+            rc_test12() || rc_test13() || rc_test14() ||
+            rc_test15() || rc_test16() || rc_test17() ||
+            rc_test18() || rc_test19() || rc_test20() ||
+            rc_test21() || rc_test22() || rc_test23() ||
+            rc_test24() || rc_test25() || rc_test26() ||
+            rc_test27() || rc_test28() || rc_test29() ||
+            rc_test30();
     }
     free(pm);
     free(rc);